@@ -0,0 +1,61 @@
+#pragma once
+#include <draw.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace bench {
+
+inline draw::RendererPtr makeRenderer(draw::Backend backend = draw::Backend::Null) {
+
+    auto renderer = draw::makeRenderer(nullptr, backend);
+    renderer->resize({1920, 1080});
+    return renderer;
+}
+
+// runs a body until the minimum time is spent and prints time per operation
+class Runner final {
+
+public:
+    explicit Runner(const char* filter) :
+        filter_(filter ? filter : "") {
+    }
+
+    bool enabled(const std::string& name) const {
+
+        return name.find(filter_) != std::string::npos;
+    }
+
+    template <typename Body>
+    void measure(const std::string& name, uint64_t operations, Body&& body) {
+
+        using Clock = std::chrono::steady_clock;
+        static const std::chrono::milliseconds kMinTime {200};
+
+        if (!enabled(name))
+            return;
+
+        uint64_t runs = 0;
+        auto start = Clock::now();
+        auto spent = Clock::duration::zero();
+        do {
+            body();
+            ++runs;
+            spent = Clock::now() - start;
+        } while (spent < kMinTime);
+
+        auto ns = std::chrono::duration<double, std::nano>(spent).count();
+        printf("%-40s %14.1f ns/op %10llu runs\n", name.c_str(),
+            ns / (runs * operations), (unsigned long long)runs);
+        fflush(stdout);
+    }
+
+private:
+    std::string filter_;
+};
+
+void benchShapes(Runner& runner);
+void benchDraw(Runner& runner);
+void benchText(Runner& runner);
+
+} // namespace bench
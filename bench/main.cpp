@@ -0,0 +1,12 @@
+#include "bench.h"
+
+// usage: draw_bench [name filter]
+int main(int argc, char* argv[]) {
+
+    bench::Runner runner(argc > 1 ? argv[1] : nullptr);
+
+    bench::benchShapes(runner);
+    bench::benchDraw(runner);
+    bench::benchText(runner);
+    return 0;
+}
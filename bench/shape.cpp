@@ -0,0 +1,88 @@
+#include "bench.h"
+#include <vector>
+
+namespace bench {
+
+static const uint32_t kShapeCounts[] = {1000, 100000};
+static const uint32_t kDrawShapeCounts[] = {1000, 10000, 100000, 1000000};
+static const uint32_t kDrawKeyCounts[] = {1, 16, 256};
+static const uint32_t kRasterShapeCounts[] = {1000, 100000};
+
+static std::vector<draw::ShapePtr> makeShapes(draw::Renderer& renderer, uint32_t count,
+    uint32_t keyCount = 1) {
+
+    std::vector<draw::ShapePtr> shapes(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& shape = shapes[i];
+        shape = renderer.makeRect();
+        shape->position({int32_t(i % 1900), int32_t(i / 1900 % 1060)});
+        shape->size({16, 16});
+        shape->order(i % keyCount);
+        shape->visibility(true);
+    }
+    return shapes;
+}
+
+void benchShapes(Runner& runner) {
+
+    for (auto count : kShapeCounts) {
+        auto suffix = "/" + std::to_string(count);
+
+        if (runner.enabled("shape/create" + suffix)) {
+            auto renderer = makeRenderer();
+            runner.measure("shape/create" + suffix, count, [&] {
+                makeShapes(*renderer, count);
+            });
+        }
+        if (runner.enabled("shape/visibility" + suffix)) {
+            auto renderer = makeRenderer();
+            auto shapes = makeShapes(*renderer, count);
+            runner.measure("shape/visibility" + suffix, count * 2, [&] {
+                for (auto& shape : shapes)
+                    shape->visibility(false);
+                for (auto& shape : shapes)
+                    shape->visibility(true);
+            });
+        }
+        if (runner.enabled("shape/order" + suffix)) {
+            auto renderer = makeRenderer();
+            auto shapes = makeShapes(*renderer, count);
+            uint32_t order = 0;
+            runner.measure("shape/order" + suffix, count, [&] {
+                ++order;
+                for (size_t i = 0; i < shapes.size(); ++i)
+                    shapes[i]->order((order + i) % 8);
+            });
+        }
+    }
+}
+
+void benchDraw(Runner& runner) {
+
+    for (auto count : kDrawShapeCounts) {
+        for (auto keys : kDrawKeyCounts) {
+            auto name = "draw/" + std::to_string(count) + "/keys:" + std::to_string(keys);
+            if (!runner.enabled(name))
+                continue;
+
+            auto renderer = makeRenderer();
+            auto shapes = makeShapes(*renderer, count, keys);
+            runner.measure(name, 1, [&] {
+                renderer->draw(0);
+            });
+        }
+    }
+    for (auto count : kRasterShapeCounts) {
+        auto name = "draw/software/" + std::to_string(count);
+        if (!runner.enabled(name))
+            continue;
+
+        auto renderer = makeRenderer(draw::Backend::Software);
+        auto shapes = makeShapes(*renderer, count);
+        runner.measure(name, 1, [&] {
+            renderer->draw(0);
+        });
+    }
+}
+
+} // namespace bench
@@ -0,0 +1,100 @@
+#include "bench.h"
+#include <file.h>
+#include <vector>
+
+namespace bench {
+
+static const char* kFontFilePath = "cour.ttf";
+static const uint32_t kTextCounts[] = {100, 10000};
+static const uint32_t kLetterSizes[] = {12, 32, 64};
+static const wchar_t* kTexts[] = {L"The quick brown fox", L"jumps over the lazy dog"};
+
+void benchText(Runner& runner) {
+
+    for (auto count : kTextCounts) {
+        auto suffix = "/" + std::to_string(count);
+
+        if (runner.enabled("text/create" + suffix)) {
+            auto renderer = makeRenderer();
+            auto font = renderer->makeFont(kFontFilePath, 12);
+            runner.measure("text/create" + suffix, count, [&] {
+                std::vector<draw::TextPtr> texts(count);
+                for (auto& text : texts) {
+                    text = renderer->makeText();
+                    text->font(font);
+                    text->text(kTexts[0]);
+                    text->visibility(true);
+                }
+            });
+        }
+        if (runner.enabled("text/relayout" + suffix)) {
+            auto renderer = makeRenderer();
+            auto font = renderer->makeFont(kFontFilePath, 12);
+            std::vector<draw::TextPtr> texts(count);
+            for (auto& text : texts) {
+                text = renderer->makeText();
+                text->font(font);
+                text->text(kTexts[0]);
+                text->visibility(true);
+            }
+            uint32_t index = 0;
+            runner.measure("text/relayout" + suffix, count, [&] {
+                ++index;
+                for (auto& text : texts)
+                    text->text(kTexts[index % 2]);
+            });
+        }
+        if (runner.enabled("text/tick" + suffix)) {
+            auto renderer = makeRenderer();
+            auto font = renderer->makeFont(kFontFilePath, 12);
+            std::vector<draw::TextPtr> texts(count);
+            for (auto& text : texts) {
+                text = renderer->makeText();
+                text->font(font);
+                text->visibility(true);
+            }
+            // price labels where only the last digits change
+            uint32_t price = 100000;
+            runner.measure("text/tick" + suffix, count, [&] {
+                auto label = L"Price: " + std::to_wstring(++price);
+                for (auto& text : texts)
+                    text->text(label.c_str());
+            });
+        }
+    }
+    for (auto letterSize : kLetterSizes) {
+        auto name = "font/atlas/" + std::to_string(letterSize);
+        if (!runner.enabled(name))
+            continue;
+
+        auto renderer = makeRenderer();
+        runner.measure(name, 1, [&] {
+            renderer->makeFont(kFontFilePath, letterSize);
+        });
+    }
+    for (auto letterSize : kLetterSizes) {
+        auto name = "font/distance/" + std::to_string(letterSize);
+        if (!runner.enabled(name))
+            continue;
+
+        auto renderer = makeRenderer();
+        runner.measure(name, 1, [&] {
+            renderer->makeFont(kFontFilePath, letterSize, true);
+        });
+    }
+    for (auto letterSize : kLetterSizes) {
+        auto name = "font/cached/" + std::to_string(letterSize);
+        if (!runner.enabled(name))
+            continue;
+
+        draw::TempDirectory cache;
+        auto renderer = makeRenderer();
+        renderer->fontCache(cache.path().c_str());
+        renderer->makeFont(kFontFilePath, letterSize);
+        runner.measure(name, 1, [&] {
+            renderer->makeFont(kFontFilePath, letterSize);
+        });
+    }
+}
+
+} // namespace bench
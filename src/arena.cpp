@@ -0,0 +1,201 @@
+#include "arena.h"
+#include <renderer.h>
+#include <algorithm>
+
+namespace draw {
+
+RangeAllocator::RangeAllocator(uint32_t size) :
+    size_(size) {
+
+    free_.emplace_back(0, size);
+}
+
+bool RangeAllocator::allocate(uint32_t size, uint32_t& offset) {
+
+    auto it = std::find_if(std::begin(free_), std::end(free_),
+        [size](const Range& range) { return range.size >= size; });
+    if (it == free_.end())
+        return false;
+
+    offset = it->offset;
+    it->offset += size;
+    it->size -= size;
+    if (it->size == 0)
+        free_.erase(it);
+    return true;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+
+    if (size == 0)
+        return;
+
+    auto it = std::lower_bound(std::begin(free_), std::end(free_), offset,
+        [](const Range& range, uint32_t value) { return range.offset < value; });
+    it = free_.emplace(it, offset, size);
+
+    auto next = it + 1;
+    if (next != free_.end() && it->offset + it->size == next->offset) {
+        it->size += next->size;
+        free_.erase(next);
+    }
+    if (it != free_.begin()) {
+        auto prev = it - 1;
+        if (prev->offset + prev->size == it->offset) {
+            prev->size += it->size;
+            free_.erase(it);
+        }
+    }
+}
+
+bool RangeAllocator::empty() const {
+
+    return free_.size() == 1 && free_[0].size == size_;
+}
+
+inline GLenum glUsage(Geometry::Usage usage) {
+
+    switch (usage) {
+    case Geometry::Usage::Static: return GL_STATIC_DRAW;
+    case Geometry::Usage::Dynamic: return GL_DYNAMIC_DRAW;
+    }
+    return 0;
+}
+
+const uint32_t GeometryArena::kPageVertexCount;
+const uint32_t GeometryArena::kPageIndexCount;
+
+GeometryArena::GeometryArena(RendererImpl& renderer, Geometry::Usage usage) :
+    renderer_(renderer),
+    usage_(usage) {
+}
+
+GeometryArena::~GeometryArena() {
+
+    ASSERT(std::all_of(std::begin(pages_), std::end(pages_),
+        [](const PagePtr& page) { return page->vertices.empty() && page->indices.empty(); }) &&
+        "all geometries must be destroyed before the arena itself");
+
+    renderer_.setContext();
+    for (auto& page : pages_) {
+        glDeleteBuffers(1, &page->vb);
+        glDeleteBuffers(1, &page->ib);
+    }
+}
+
+GeometryArena::Page* GeometryArena::makePage(uint32_t vertexCount, uint32_t indexCount) {
+
+    renderer_.setContext();
+
+    auto page = make_unique<Page>(std::max(vertexCount, kPageVertexCount),
+        std::max(indexCount, kPageIndexCount));
+    if (renderer_.software()) {
+        page->vertexData.resize(page->vertices.size());
+        page->indexData.resize(page->indices.size());
+    }
+    auto usage = glUsage(usage_);
+
+    glGenBuffers(1, &page->vb);
+    glBindBuffer(GL_ARRAY_BUFFER, page->vb);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Geometry::Vertex) * page->vertices.size(),
+        nullptr, usage);
+
+    glGenBuffers(1, &page->ib);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page->ib);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Geometry::Index) * page->indices.size(),
+        nullptr, usage);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        glDeleteBuffers(1, &page->vb);
+        glDeleteBuffers(1, &page->ib);
+        return nullptr;
+    }
+    pages_.emplace_back(std::move(page));
+    return pages_.back().get();
+}
+
+void GeometryArena::deletePage(Page* page) {
+
+    auto it = std::find_if(std::begin(pages_), std::end(pages_),
+        [page](const PagePtr& e) { return page == e.get(); });
+    ASSERT(it != pages_.end() && "page is not exist");
+
+    renderer_.setContext();
+    glDeleteBuffers(1, &page->vb);
+    glDeleteBuffers(1, &page->ib);
+    pages_.erase(it);
+}
+
+inline bool allocatePage(GeometryArena::Page& page, uint32_t vertexCount,
+    uint32_t indexCount, GeometryArena::Allocation& allocation) {
+
+    if (!page.vertices.allocate(vertexCount, allocation.baseVertex))
+        return false;
+    if (!page.indices.allocate(indexCount, allocation.firstIndex)) {
+        page.vertices.free(allocation.baseVertex, vertexCount);
+        return false;
+    }
+    allocation.page = &page;
+    allocation.vertexCount = vertexCount;
+    allocation.indexCount = indexCount;
+    return true;
+}
+
+bool GeometryArena::allocate(uint32_t vertexCount, uint32_t indexCount,
+    Allocation& allocation) {
+
+    for (auto& page : pages_) {
+        if (allocatePage(*page, vertexCount, indexCount, allocation))
+            return true;
+    }
+    auto page = makePage(vertexCount, indexCount);
+    return page && allocatePage(*page, vertexCount, indexCount, allocation);
+}
+
+void GeometryArena::free(Allocation& allocation) {
+
+    auto page = allocation.page;
+    if (!page)
+        return;
+
+    page->vertices.free(allocation.baseVertex, allocation.vertexCount);
+    page->indices.free(allocation.firstIndex, allocation.indexCount);
+    allocation = Allocation();
+
+    if (page != pages_.front().get() &&
+        page->vertices.empty() && page->indices.empty())
+        deletePage(page);
+}
+
+void GeometryArena::upload(const Allocation& allocation, uint32_t vertexOffset,
+    Geometry::Vertices vertices, uint32_t indexOffset, Geometry::Indices indices) {
+
+    ASSERT(allocation.page && "allocation is invalid");
+    ASSERT(vertexOffset <= allocation.vertexCount &&
+        vertices.count <= allocation.vertexCount - vertexOffset);
+    ASSERT(indexOffset <= allocation.indexCount &&
+        indices.count <= allocation.indexCount - indexOffset);
+
+    renderer_.setContext();
+
+    if (renderer_.software()) {
+        std::copy(vertices.ptr, vertices.ptr + vertices.count,
+            allocation.page->vertexData.data() + allocation.baseVertex + vertexOffset);
+        std::copy(indices.ptr, indices.ptr + indices.count,
+            allocation.page->indexData.data() + allocation.firstIndex + indexOffset);
+    }
+    if (vertices.count > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, allocation.page->vb);
+        glBufferSubData(GL_ARRAY_BUFFER,
+            sizeof(Geometry::Vertex) * (allocation.baseVertex + vertexOffset),
+            sizeof(Geometry::Vertex) * vertices.count, vertices.ptr);
+    }
+    if (indices.count > 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, allocation.page->ib);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+            sizeof(Geometry::Index) * (allocation.firstIndex + indexOffset),
+            sizeof(Geometry::Index) * indices.count, indices.ptr);
+    }
+}
+
+} // namespace draw
@@ -0,0 +1,86 @@
+#pragma once
+#include <draw.h>
+#include <opengl.h>
+#include <memory>
+#include <vector>
+
+namespace draw {
+
+class RendererImpl;
+
+class RangeAllocator {
+
+public:
+    RangeAllocator(uint32_t size);
+    ~RangeAllocator() = default;
+
+    bool allocate(uint32_t size, uint32_t& offset);
+    void free(uint32_t offset, uint32_t size);
+    bool empty() const;
+    uint32_t size() const { return size_; }
+
+private:
+    struct Range {
+
+        uint32_t offset {0};
+        uint32_t size {0};
+
+        Range(uint32_t offset, uint32_t size) :
+            offset(offset), size(size) {}
+    };
+    uint32_t size_ {0};
+    std::vector<Range> free_;
+};
+
+class GeometryArena {
+
+public:
+    struct Page {
+
+        GLuint vb {0};
+        GLuint ib {0};
+        RangeAllocator vertices;
+        RangeAllocator indices;
+        // copies read by the rasterizer of Backend::Software
+        std::vector<Geometry::Vertex> vertexData;
+        std::vector<Geometry::Index> indexData;
+
+        Page(uint32_t vertexCount, uint32_t indexCount) :
+            vertices(vertexCount), indices(indexCount) {}
+    };
+
+    struct Allocation {
+
+        Page* page {nullptr};
+        uint32_t baseVertex {0};
+        uint32_t firstIndex {0};
+        uint32_t vertexCount {0};
+        uint32_t indexCount {0};
+    };
+
+    GeometryArena(RendererImpl& renderer, Geometry::Usage usage);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator = (const GeometryArena&) = delete;
+
+    bool allocate(uint32_t vertexCount, uint32_t indexCount, Allocation& allocation);
+    void free(Allocation& allocation);
+    void upload(const Allocation& allocation, uint32_t vertexOffset, Geometry::Vertices vertices,
+        uint32_t indexOffset, Geometry::Indices indices);
+
+private:
+    static const uint32_t kPageVertexCount {Geometry::kMaxVertexCount + 1};
+    static const uint32_t kPageIndexCount {kPageVertexCount * 3};
+
+    using PagePtr = std::unique_ptr<Page>;
+
+    Page* makePage(uint32_t vertexCount, uint32_t indexCount);
+    void deletePage(Page* page);
+
+    RendererImpl& renderer_;
+    Geometry::Usage usage_;
+    std::vector<PagePtr> pages_;
+};
+
+} // namespace draw
@@ -0,0 +1,280 @@
+#define DRAW_GL_DIRECT
+#include <opengl.h>
+#include <atomic>
+#include <cstring>
+
+namespace draw {
+
+namespace opengl {
+
+#ifndef _DRAW_BENCH
+GLenum GlewInit() { return glewInit(); }
+GLboolean GlewIsSupported(const char* name) { return glewIsSupported(name); }
+#define DRAW_GL_CALL(result, name, params, args) \
+    result name params { return gl##name args; }
+DRAW_GL_FUNCTIONS(DRAW_GL_CALL)
+#undef DRAW_GL_CALL
+#endif
+
+} // namespace opengl
+
+namespace null {
+
+// entry points which do nothing, so the library runs without a GPU
+
+void count(GLFunction function, uint64_t bytes = 0) {
+
+    if (gGLCalls) {
+        ++gGLCalls[function].calls;
+        gGLCalls[function].bytes += bytes;
+    }
+}
+
+// names are unique across renderers of all threads
+GLuint newName() {
+
+    static std::atomic<GLuint> name(0);
+    return ++name;
+}
+
+void genNames(GLsizei n, GLuint* names) {
+
+    for (GLsizei i = 0; i < n; ++i)
+        names[i] = newName();
+}
+
+uint64_t pixelBytes(GLsizei width, GLsizei height, GLenum format, GLenum type,
+    const GLvoid* pixels) {
+
+    if (!pixels)
+        return 0;
+    uint64_t size = 4;
+    if (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4)
+        size = 2;
+    else if (format == GL_ALPHA)
+        size = 1;
+    else if (format == GL_RGB)
+        size = 3;
+    return size * width * height;
+}
+
+GLenum GlewInit() { count(kGlewInit); return GLEW_OK; }
+
+GLboolean GlewIsSupported(const char* name) {
+
+    count(kGlewIsSupported);
+    // there is no buffer storage to map, so pixel streams use CPU memory
+    return strcmp(name, "GL_ARB_pixel_buffer_object") != 0 ? GL_TRUE : GL_FALSE;
+}
+
+GLenum GetError() { count(kGLGetError); return GL_NO_ERROR; }
+
+void GenBuffers(GLsizei n, GLuint* buffers) { count(kGLGenBuffers); genNames(n, buffers); }
+void DeleteBuffers(GLsizei, const GLuint*) { count(kGLDeleteBuffers); }
+void BindBuffer(GLenum, GLuint) { count(kGLBindBuffer); }
+
+void BufferData(GLenum, GLsizeiptr size, const GLvoid* data, GLenum) {
+
+    count(kGLBufferData, data ? size : 0);
+}
+
+void BufferSubData(GLenum, GLintptr, GLsizeiptr size, const GLvoid*) {
+
+    count(kGLBufferSubData, size);
+}
+
+GLvoid* MapBuffer(GLenum, GLenum) { count(kGLMapBuffer); return nullptr; }
+GLboolean UnmapBuffer(GLenum) { count(kGLUnmapBuffer); return GL_TRUE; }
+
+void GenTextures(GLsizei n, GLuint* textures) { count(kGLGenTextures); genNames(n, textures); }
+void DeleteTextures(GLsizei, const GLuint*) { count(kGLDeleteTextures); }
+void BindTexture(GLenum, GLuint) { count(kGLBindTexture); }
+void ActiveTexture(GLenum) { count(kGLActiveTexture); }
+void TexParameteri(GLenum, GLenum, GLint) { count(kGLTexParameteri); }
+void PixelStorei(GLenum, GLint) { count(kGLPixelStorei); }
+
+void TexImage2D(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint, GLenum format,
+    GLenum type, const GLvoid* pixels) {
+
+    count(kGLTexImage2D, pixelBytes(width, height, format, type, pixels));
+}
+
+void TexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format,
+    GLenum type, const GLvoid* pixels) {
+
+    count(kGLTexSubImage2D, pixelBytes(width, height, format, type, pixels));
+}
+
+void CompressedTexImage2D(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei imageSize,
+    const GLvoid* data) {
+
+    count(kGLCompressedTexImage2D, data ? imageSize : 0);
+}
+
+void CompressedTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum,
+    GLsizei imageSize, const GLvoid*) {
+
+    count(kGLCompressedTexSubImage2D, imageSize);
+}
+
+void GenerateMipmap(GLenum) { count(kGLGenerateMipmap); }
+
+GLuint CreateShader(GLenum) { count(kGLCreateShader); return newName(); }
+void DeleteShader(GLuint) { count(kGLDeleteShader); }
+void ShaderSource(GLuint, GLsizei, const GLchar**, const GLint*) { count(kGLShaderSource); }
+void CompileShader(GLuint) { count(kGLCompileShader); }
+void GetShaderiv(GLuint, GLenum, GLint* param) { count(kGLGetShaderiv); *param = GL_TRUE; }
+GLuint CreateProgram() { count(kGLCreateProgram); return newName(); }
+void DeleteProgram(GLuint) { count(kGLDeleteProgram); }
+void AttachShader(GLuint, GLuint) { count(kGLAttachShader); }
+void LinkProgram(GLuint) { count(kGLLinkProgram); }
+void GetProgramiv(GLuint, GLenum, GLint* param) { count(kGLGetProgramiv); *param = GL_TRUE; }
+GLint GetUniformLocation(GLuint, const GLchar*) { count(kGLGetUniformLocation); return 0; }
+GLint GetAttribLocation(GLuint, const GLchar*) { count(kGLGetAttribLocation); return 0; }
+void UseProgram(GLuint) { count(kGLUseProgram); }
+void Uniform1i(GLint, GLint) { count(kGLUniform1i); }
+void Uniform2fv(GLint, GLsizei, const GLfloat*) { count(kGLUniform2fv); }
+
+void EnableVertexAttribArray(GLuint) { count(kGLEnableVertexAttribArray); }
+
+void VertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid*) {
+
+    count(kGLVertexAttribPointer);
+}
+
+void VertexAttribDivisor(GLuint, GLuint) { count(kGLVertexAttribDivisor); }
+
+void DrawElementsInstanced(GLenum, GLsizei, GLenum, const GLvoid*, GLsizei) {
+
+    count(kGLDrawElementsInstanced);
+}
+
+void DrawElementsInstancedBaseVertex(GLenum, GLsizei, GLenum, const GLvoid*, GLsizei, GLint) {
+
+    count(kGLDrawElementsInstancedBaseVertex);
+}
+
+void Enable(GLenum) { count(kGLEnable); }
+void Disable(GLenum) { count(kGLDisable); }
+void DepthMask(GLboolean) { count(kGLDepthMask); }
+void BlendEquation(GLenum) { count(kGLBlendEquation); }
+void BlendFunc(GLenum, GLenum) { count(kGLBlendFunc); }
+void Viewport(GLint, GLint, GLsizei, GLsizei) { count(kGLViewport); }
+void Clear(GLbitfield) { count(kGLClear); }
+void ClearColor(GLclampf, GLclampf, GLclampf, GLclampf) { count(kGLClearColor); }
+void ClearDepth(GLclampd) { count(kGLClearDepth); }
+
+void GenQueries(GLsizei n, GLuint* ids) { count(kGLGenQueries); genNames(n, ids); }
+void DeleteQueries(GLsizei, const GLuint*) { count(kGLDeleteQueries); }
+void BeginQuery(GLenum, GLuint) { count(kGLBeginQuery); }
+void EndQuery(GLenum) { count(kGLEndQuery); }
+void QueryCounter(GLuint, GLenum) { count(kGLQueryCounter); }
+
+void GetQueryObjectiv(GLuint, GLenum, GLint* params) {
+
+    count(kGLGetQueryObjectiv);
+    *params = GL_TRUE;
+}
+
+void GetQueryObjectui64v(GLuint, GLenum, GLuint64* params) {
+
+    count(kGLGetQueryObjectui64v);
+    *params = 0;
+}
+
+void GenFramebuffers(GLsizei n, GLuint* framebuffers) {
+
+    count(kGLGenFramebuffers);
+    genNames(n, framebuffers);
+}
+
+void DeleteFramebuffers(GLsizei, const GLuint*) { count(kGLDeleteFramebuffers); }
+void BindFramebuffer(GLenum, GLuint) { count(kGLBindFramebuffer); }
+void FramebufferRenderbuffer(GLenum, GLenum, GLenum, GLuint) { count(kGLFramebufferRenderbuffer); }
+
+GLenum CheckFramebufferStatus(GLenum) {
+
+    count(kGLCheckFramebufferStatus);
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+void GenRenderbuffers(GLsizei n, GLuint* renderbuffers) {
+
+    count(kGLGenRenderbuffers);
+    genNames(n, renderbuffers);
+}
+
+void DeleteRenderbuffers(GLsizei, const GLuint*) { count(kGLDeleteRenderbuffers); }
+void BindRenderbuffer(GLenum, GLuint) { count(kGLBindRenderbuffer); }
+void RenderbufferStorage(GLenum, GLenum, GLsizei, GLsizei) { count(kGLRenderbufferStorage); }
+
+void ReadPixels(GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type,
+    GLvoid* pixels) {
+
+    // pixels are left as they are, a pixel buffer is read to when they are nullptr
+    static const uint8_t kPixelBuffer = 0;
+    count(kGLReadPixels, pixelBytes(width, height, format, type,
+        pixels ? pixels : &kPixelBuffer));
+}
+
+GLsync FenceSync(GLenum, GLbitfield) {
+
+    count(kGLFenceSync);
+    return reinterpret_cast<GLsync>((uintptr_t)newName());
+}
+
+GLenum ClientWaitSync(GLsync, GLbitfield, GLuint64) {
+
+    count(kGLClientWaitSync);
+    return GL_ALREADY_SIGNALED;
+}
+
+void DeleteSync(GLsync) { count(kGLDeleteSync); }
+
+} // namespace null
+
+#define DRAW_GL_NULL(result, name, params, args) null::name,
+#define DRAW_GL_OPENGL(result, name, params, args) opengl::name,
+#define DRAW_GL_NAME(result, name, params, args) "gl" #name,
+
+static const GLFunctions kNull = {
+    null::GlewInit,
+    null::GlewIsSupported,
+    DRAW_GL_FUNCTIONS(DRAW_GL_NULL)
+};
+
+#ifdef _DRAW_BENCH
+// benchmarks are built without OpenGL libraries
+static const GLFunctions& kOpenGL = kNull;
+#else
+static const GLFunctions kOpenGL = {
+    opengl::GlewInit,
+    opengl::GlewIsSupported,
+    DRAW_GL_FUNCTIONS(DRAW_GL_OPENGL)
+};
+#endif
+
+static const char* const kNames[kGLFunctionCount] = {
+    "glewInit",
+    "glewIsSupported",
+    DRAW_GL_FUNCTIONS(DRAW_GL_NAME)
+};
+
+#undef DRAW_GL_NULL
+#undef DRAW_GL_OPENGL
+#undef DRAW_GL_NAME
+
+thread_local const GLFunctions* gGL = &kOpenGL;
+thread_local GLCalls* gGLCalls = nullptr;
+
+const GLFunctions& getGLFunctions(Backend backend) {
+
+    return backend == Backend::OpenGL ? kOpenGL : kNull;
+}
+
+const char* getGLFunctionName(GLFunction function) {
+
+    return kNames[function];
+}
+
+} // namespace draw
@@ -0,0 +1,277 @@
+#pragma once
+#include <draw.h>
+
+// OpenGL entry points used by the library: F(result, name without 'gl' prefix, params, args)
+#define DRAW_GL_FUNCTIONS(F) \
+    F(GLenum, GetError, (), ()) \
+    F(void, GenBuffers, (GLsizei n, GLuint* buffers), (n, buffers)) \
+    F(void, DeleteBuffers, (GLsizei n, const GLuint* buffers), (n, buffers)) \
+    F(void, BindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+    F(void, BufferData, (GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage), \
+        (target, size, data, usage)) \
+    F(void, BufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, \
+        const GLvoid* data), (target, offset, size, data)) \
+    F(GLvoid*, MapBuffer, (GLenum target, GLenum access), (target, access)) \
+    F(GLboolean, UnmapBuffer, (GLenum target), (target)) \
+    F(void, GenTextures, (GLsizei n, GLuint* textures), (n, textures)) \
+    F(void, DeleteTextures, (GLsizei n, const GLuint* textures), (n, textures)) \
+    F(void, BindTexture, (GLenum target, GLuint texture), (target, texture)) \
+    F(void, ActiveTexture, (GLenum texture), (texture)) \
+    F(void, TexParameteri, (GLenum target, GLenum pname, GLint param), \
+        (target, pname, param)) \
+    F(void, PixelStorei, (GLenum pname, GLint param), (pname, param)) \
+    F(void, TexImage2D, (GLenum target, GLint level, GLint internalFormat, GLsizei width, \
+        GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* pixels), \
+        (target, level, internalFormat, width, height, border, format, type, pixels)) \
+    F(void, TexSubImage2D, (GLenum target, GLint level, GLint x, GLint y, GLsizei width, \
+        GLsizei height, GLenum format, GLenum type, const GLvoid* pixels), \
+        (target, level, x, y, width, height, format, type, pixels)) \
+    F(void, CompressedTexImage2D, (GLenum target, GLint level, GLenum internalFormat, \
+        GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid* data), \
+        (target, level, internalFormat, width, height, border, imageSize, data)) \
+    F(void, CompressedTexSubImage2D, (GLenum target, GLint level, GLint x, GLint y, \
+        GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid* data), \
+        (target, level, x, y, width, height, format, imageSize, data)) \
+    F(void, GenerateMipmap, (GLenum target), (target)) \
+    F(GLuint, CreateShader, (GLenum type), (type)) \
+    F(void, DeleteShader, (GLuint shader), (shader)) \
+    F(void, ShaderSource, (GLuint shader, GLsizei count, const GLchar** strings, \
+        const GLint* lengths), (shader, count, strings, lengths)) \
+    F(void, CompileShader, (GLuint shader), (shader)) \
+    F(void, GetShaderiv, (GLuint shader, GLenum pname, GLint* param), (shader, pname, param)) \
+    F(GLuint, CreateProgram, (), ()) \
+    F(void, DeleteProgram, (GLuint program), (program)) \
+    F(void, AttachShader, (GLuint program, GLuint shader), (program, shader)) \
+    F(void, LinkProgram, (GLuint program), (program)) \
+    F(void, GetProgramiv, (GLuint program, GLenum pname, GLint* param), \
+        (program, pname, param)) \
+    F(GLint, GetUniformLocation, (GLuint program, const GLchar* name), (program, name)) \
+    F(GLint, GetAttribLocation, (GLuint program, const GLchar* name), (program, name)) \
+    F(void, UseProgram, (GLuint program), (program)) \
+    F(void, Uniform1i, (GLint location, GLint v0), (location, v0)) \
+    F(void, Uniform2fv, (GLint location, GLsizei count, const GLfloat* value), \
+        (location, count, value)) \
+    F(void, EnableVertexAttribArray, (GLuint index), (index)) \
+    F(void, VertexAttribPointer, (GLuint index, GLint size, GLenum type, \
+        GLboolean normalized, GLsizei stride, const GLvoid* pointer), \
+        (index, size, type, normalized, stride, pointer)) \
+    F(void, VertexAttribDivisor, (GLuint index, GLuint divisor), (index, divisor)) \
+    F(void, DrawElementsInstanced, (GLenum mode, GLsizei count, GLenum type, \
+        const GLvoid* indices, GLsizei primcount), (mode, count, type, indices, primcount)) \
+    F(void, DrawElementsInstancedBaseVertex, (GLenum mode, GLsizei count, GLenum type, \
+        const GLvoid* indices, GLsizei primcount, GLint baseVertex), \
+        (mode, count, type, indices, primcount, baseVertex)) \
+    F(void, Enable, (GLenum cap), (cap)) \
+    F(void, Disable, (GLenum cap), (cap)) \
+    F(void, DepthMask, (GLboolean flag), (flag)) \
+    F(void, BlendEquation, (GLenum mode), (mode)) \
+    F(void, BlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor)) \
+    F(void, Viewport, (GLint x, GLint y, GLsizei width, GLsizei height), \
+        (x, y, width, height)) \
+    F(void, Clear, (GLbitfield mask), (mask)) \
+    F(void, ClearColor, (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha), \
+        (red, green, blue, alpha)) \
+    F(void, ClearDepth, (GLclampd depth), (depth)) \
+    F(void, GenQueries, (GLsizei n, GLuint* ids), (n, ids)) \
+    F(void, DeleteQueries, (GLsizei n, const GLuint* ids), (n, ids)) \
+    F(void, BeginQuery, (GLenum target, GLuint id), (target, id)) \
+    F(void, EndQuery, (GLenum target), (target)) \
+    F(void, QueryCounter, (GLuint id, GLenum target), (id, target)) \
+    F(void, GetQueryObjectiv, (GLuint id, GLenum pname, GLint* params), (id, pname, params)) \
+    F(void, GetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64* params), \
+        (id, pname, params)) \
+    F(void, GenFramebuffers, (GLsizei n, GLuint* framebuffers), (n, framebuffers)) \
+    F(void, DeleteFramebuffers, (GLsizei n, const GLuint* framebuffers), (n, framebuffers)) \
+    F(void, BindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer)) \
+    F(void, FramebufferRenderbuffer, (GLenum target, GLenum attachment, \
+        GLenum renderbufferTarget, GLuint renderbuffer), \
+        (target, attachment, renderbufferTarget, renderbuffer)) \
+    F(GLenum, CheckFramebufferStatus, (GLenum target), (target)) \
+    F(void, GenRenderbuffers, (GLsizei n, GLuint* renderbuffers), (n, renderbuffers)) \
+    F(void, DeleteRenderbuffers, (GLsizei n, const GLuint* renderbuffers), (n, renderbuffers)) \
+    F(void, BindRenderbuffer, (GLenum target, GLuint renderbuffer), (target, renderbuffer)) \
+    F(void, RenderbufferStorage, (GLenum target, GLenum internalFormat, GLsizei width, \
+        GLsizei height), (target, internalFormat, width, height)) \
+    F(void, ReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, \
+        GLenum type, GLvoid* pixels), (x, y, width, height, format, type, pixels)) \
+    F(GLsync, FenceSync, (GLenum condition, GLbitfield flags), (condition, flags)) \
+    F(GLenum, ClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), \
+        (sync, flags, timeout)) \
+    F(void, DeleteSync, (GLsync sync), (sync))
+
+namespace draw {
+
+enum GLFunction {
+
+    kGlewInit,
+    kGlewIsSupported,
+#define DRAW_GL_ENUM(result, name, params, args) kGL##name,
+    DRAW_GL_FUNCTIONS(DRAW_GL_ENUM)
+#undef DRAW_GL_ENUM
+    kGLFunctionCount
+};
+
+// table of entry points, all OpenGL calls of the library go through the current one
+struct GLFunctions {
+
+    GLenum (*GlewInit)();
+    GLboolean (*GlewIsSupported)(const char* name);
+#define DRAW_GL_POINTER(result, name, params, args) result (*name) params;
+    DRAW_GL_FUNCTIONS(DRAW_GL_POINTER)
+#undef DRAW_GL_POINTER
+};
+
+// tables are switched with the renderer context, so like the current OpenGL context
+// the current table of a thread belongs to the renderer it used last
+extern thread_local const GLFunctions* gGL;
+// counters of Backend::Counting indexed by GLFunction, otherwise nullptr
+extern thread_local GLCalls* gGLCalls;
+
+const GLFunctions& getGLFunctions(Backend backend);
+const char* getGLFunctionName(GLFunction function);
+
+} // namespace draw
+
+// opengl.h of the backend itself includes this header with the original entry points
+#ifndef DRAW_GL_DIRECT
+#undef glewInit
+#define glewInit ::draw::gGL->GlewInit
+#undef glewIsSupported
+#define glewIsSupported ::draw::gGL->GlewIsSupported
+#undef glGetError
+#define glGetError ::draw::gGL->GetError
+#undef glGenBuffers
+#define glGenBuffers ::draw::gGL->GenBuffers
+#undef glDeleteBuffers
+#define glDeleteBuffers ::draw::gGL->DeleteBuffers
+#undef glBindBuffer
+#define glBindBuffer ::draw::gGL->BindBuffer
+#undef glBufferData
+#define glBufferData ::draw::gGL->BufferData
+#undef glBufferSubData
+#define glBufferSubData ::draw::gGL->BufferSubData
+#undef glMapBuffer
+#define glMapBuffer ::draw::gGL->MapBuffer
+#undef glUnmapBuffer
+#define glUnmapBuffer ::draw::gGL->UnmapBuffer
+#undef glGenTextures
+#define glGenTextures ::draw::gGL->GenTextures
+#undef glDeleteTextures
+#define glDeleteTextures ::draw::gGL->DeleteTextures
+#undef glBindTexture
+#define glBindTexture ::draw::gGL->BindTexture
+#undef glActiveTexture
+#define glActiveTexture ::draw::gGL->ActiveTexture
+#undef glTexParameteri
+#define glTexParameteri ::draw::gGL->TexParameteri
+#undef glPixelStorei
+#define glPixelStorei ::draw::gGL->PixelStorei
+#undef glTexImage2D
+#define glTexImage2D ::draw::gGL->TexImage2D
+#undef glTexSubImage2D
+#define glTexSubImage2D ::draw::gGL->TexSubImage2D
+#undef glCompressedTexImage2D
+#define glCompressedTexImage2D ::draw::gGL->CompressedTexImage2D
+#undef glCompressedTexSubImage2D
+#define glCompressedTexSubImage2D ::draw::gGL->CompressedTexSubImage2D
+#undef glGenerateMipmap
+#define glGenerateMipmap ::draw::gGL->GenerateMipmap
+#undef glCreateShader
+#define glCreateShader ::draw::gGL->CreateShader
+#undef glDeleteShader
+#define glDeleteShader ::draw::gGL->DeleteShader
+#undef glShaderSource
+#define glShaderSource ::draw::gGL->ShaderSource
+#undef glCompileShader
+#define glCompileShader ::draw::gGL->CompileShader
+#undef glGetShaderiv
+#define glGetShaderiv ::draw::gGL->GetShaderiv
+#undef glCreateProgram
+#define glCreateProgram ::draw::gGL->CreateProgram
+#undef glDeleteProgram
+#define glDeleteProgram ::draw::gGL->DeleteProgram
+#undef glAttachShader
+#define glAttachShader ::draw::gGL->AttachShader
+#undef glLinkProgram
+#define glLinkProgram ::draw::gGL->LinkProgram
+#undef glGetProgramiv
+#define glGetProgramiv ::draw::gGL->GetProgramiv
+#undef glGetUniformLocation
+#define glGetUniformLocation ::draw::gGL->GetUniformLocation
+#undef glGetAttribLocation
+#define glGetAttribLocation ::draw::gGL->GetAttribLocation
+#undef glUseProgram
+#define glUseProgram ::draw::gGL->UseProgram
+#undef glUniform1i
+#define glUniform1i ::draw::gGL->Uniform1i
+#undef glUniform2fv
+#define glUniform2fv ::draw::gGL->Uniform2fv
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray ::draw::gGL->EnableVertexAttribArray
+#undef glVertexAttribPointer
+#define glVertexAttribPointer ::draw::gGL->VertexAttribPointer
+#undef glVertexAttribDivisor
+#define glVertexAttribDivisor ::draw::gGL->VertexAttribDivisor
+#undef glDrawElementsInstanced
+#define glDrawElementsInstanced ::draw::gGL->DrawElementsInstanced
+#undef glDrawElementsInstancedBaseVertex
+#define glDrawElementsInstancedBaseVertex ::draw::gGL->DrawElementsInstancedBaseVertex
+#undef glEnable
+#define glEnable ::draw::gGL->Enable
+#undef glDisable
+#define glDisable ::draw::gGL->Disable
+#undef glDepthMask
+#define glDepthMask ::draw::gGL->DepthMask
+#undef glBlendEquation
+#define glBlendEquation ::draw::gGL->BlendEquation
+#undef glBlendFunc
+#define glBlendFunc ::draw::gGL->BlendFunc
+#undef glViewport
+#define glViewport ::draw::gGL->Viewport
+#undef glClear
+#define glClear ::draw::gGL->Clear
+#undef glClearColor
+#define glClearColor ::draw::gGL->ClearColor
+#undef glClearDepth
+#define glClearDepth ::draw::gGL->ClearDepth
+#undef glGenQueries
+#define glGenQueries ::draw::gGL->GenQueries
+#undef glDeleteQueries
+#define glDeleteQueries ::draw::gGL->DeleteQueries
+#undef glBeginQuery
+#define glBeginQuery ::draw::gGL->BeginQuery
+#undef glEndQuery
+#define glEndQuery ::draw::gGL->EndQuery
+#undef glQueryCounter
+#define glQueryCounter ::draw::gGL->QueryCounter
+#undef glGetQueryObjectiv
+#define glGetQueryObjectiv ::draw::gGL->GetQueryObjectiv
+#undef glGetQueryObjectui64v
+#define glGetQueryObjectui64v ::draw::gGL->GetQueryObjectui64v
+#undef glGenFramebuffers
+#define glGenFramebuffers ::draw::gGL->GenFramebuffers
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers ::draw::gGL->DeleteFramebuffers
+#undef glBindFramebuffer
+#define glBindFramebuffer ::draw::gGL->BindFramebuffer
+#undef glFramebufferRenderbuffer
+#define glFramebufferRenderbuffer ::draw::gGL->FramebufferRenderbuffer
+#undef glCheckFramebufferStatus
+#define glCheckFramebufferStatus ::draw::gGL->CheckFramebufferStatus
+#undef glGenRenderbuffers
+#define glGenRenderbuffers ::draw::gGL->GenRenderbuffers
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers ::draw::gGL->DeleteRenderbuffers
+#undef glBindRenderbuffer
+#define glBindRenderbuffer ::draw::gGL->BindRenderbuffer
+#undef glRenderbufferStorage
+#define glRenderbufferStorage ::draw::gGL->RenderbufferStorage
+#undef glReadPixels
+#define glReadPixels ::draw::gGL->ReadPixels
+#undef glFenceSync
+#define glFenceSync ::draw::gGL->FenceSync
+#undef glClientWaitSync
+#define glClientWaitSync ::draw::gGL->ClientWaitSync
+#undef glDeleteSync
+#define glDeleteSync ::draw::gGL->DeleteSync
+#endif
@@ -1,5 +1,7 @@
 #pragma once
+#include <cstring>
 #include <memory>
+#include <vector>
 
 #if defined(__clang__)
 #if __has_feature(cxx_noexcept)
@@ -40,11 +42,21 @@ struct Instance {
     uint32_t color {0xFFFFFFFF};
 };
 
+// instances added to a batch and removed from it as a single unit (e.g. glyphs of a text),
+// their positions are relative to the origin, which is added when they are uploaded
+struct InstanceRun {
+
+    float originX {0.0f};
+    float originY {0.0f};
+    std::vector<Instance> instances;
+};
+
 enum class FillMode {
 
     Solid = 0,
     Transparent,
-    Font
+    Font,
+    DistanceFont
 };
 
 struct Key {
@@ -79,6 +91,38 @@ struct Key {
     }
 };
 
+static const uint64_t kHashSeed = 14695981039346656037ULL;
+
+// content is hashed by words in four independent chains, so the multiplications of the
+// chains overlap, the tail is hashed by bytes
+inline uint64_t hash(const void* data, size_t size, uint64_t seed = kHashSeed) {
+
+    static const uint64_t kPrime = 1099511628211ULL;
+    static const size_t kLanes = 4;
+
+    auto bytes = static_cast<const uint8_t*>(data);
+    uint64_t lanes[kLanes] = {seed, seed ^ 1, seed ^ 2, seed ^ 3};
+    size_t i = 0;
+    for (; i + sizeof(lanes) <= size; i += sizeof(lanes)) {
+        uint64_t words[kLanes];
+        memcpy(words, bytes + i, sizeof(words));
+        for (size_t lane = 0; lane < kLanes; ++lane) {
+            lanes[lane] = (lanes[lane] ^ words[lane]) * kPrime;
+            lanes[lane] ^= lanes[lane] >> 29;
+        }
+    }
+    auto result = seed;
+    if (i > 0) {
+        for (auto lane : lanes)
+            result = (result ^ lane) * kPrime;
+    }
+    for (; i < size; ++i) {
+        result ^= bytes[i];
+        result *= kPrime;
+    }
+    return result;
+}
+
 template<typename T, typename... Args>
 std::unique_ptr<T> make_unique(Args&&... args) {
     return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
@@ -7,6 +7,7 @@
 #pragma once
 #include <stdint.h>
 #include <memory>
+#include <functional>
 
 #ifndef ASSERT
 #include <cassert>
@@ -179,6 +180,12 @@ public:
         Line, /*!< consumes 2 index per primitive */
         Triangle /*!< consumes 3 index per primitive */
     };
+    //! A usage hint of geometry buffers.
+    enum class Usage {
+
+        Static, /*!< vertices and indices are specified once */
+        Dynamic /*!< vertices and indices are updated frequently */
+    };
     virtual ~Geometry() = default;
     //! return vertex count
     virtual uint32_t vertexCount() const = 0;
@@ -186,6 +193,32 @@ public:
     virtual uint32_t indexCount() const = 0;
     //! return primitive type
     virtual Primitive primitive() const = 0;
+    //! return usage hint
+    virtual Usage usage() const = 0;
+    //! return vertex count which can be held without reallocation
+    virtual uint32_t vertexCapacity() const = 0;
+    //! return index count which can be held without reallocation
+    virtual uint32_t indexCapacity() const = 0;
+    //! update a range of vertices and a range of indices
+    /*!
+      Vertices are written starting from vertexOffset and indices starting from indexOffset.
+      Vertex and index counts grow to cover the written ranges. Pass an empty span
+      to leave the corresponding buffer untouched.
+      \throw draw::InvalidArgument if usage is not Usage::Dynamic
+      \throw draw::InvalidArgument if vertices.data or indices.data is invalid and count is not zero
+      \throw draw::InvalidArgument if vertexOffset + vertices.count > vertexCapacity
+      \throw draw::InvalidArgument if indexOffset + indices.count > indexCapacity
+      \throw draw::InvalidArgument if an index is not less than vertexCapacity
+    */
+    virtual void update(uint32_t vertexOffset, Vertices vertices,
+        uint32_t indexOffset, Indices indices) = 0;
+    //! set vertex and index counts (e.g. to shrink a polyline)
+    /*!
+      \throw draw::InvalidArgument if usage is not Usage::Dynamic
+      \throw draw::InvalidArgument if vertexCount > vertexCapacity
+      \throw draw::InvalidArgument if indexCount > indexCapacity
+    */
+    virtual void resize(uint32_t vertexCount, uint32_t indexCount) = 0;
 };
 
 using GeometryPtr = SHARED_PTR<Geometry>;
@@ -203,6 +236,10 @@ class Image {
 public:
     //! maximum available size of image's width and height
     static const uint32_t kMaxSize = 4096;
+    //! minimum count of frame buffers of a streaming image
+    static const uint32_t kMinStreamBuffers = 2;
+    //! maximum count of frame buffers of a streaming image
+    static const uint32_t kMaxStreamBuffers = 3;
     //! Sequence of bytes.
     using Bytes = Span<uint8_t>;
     //! A pixel format.
@@ -210,8 +247,18 @@ public:
 
         A, /*!< 1 byte per pixel (alpha only) */
         RGB, /*!< 3 bytes per pixel (1-red, 1-green, 1-blue) */
-        RGBA /*!< 4 bytes per pixel (1-red, 1-green, 1-blue, 1-alpha) */
+        RGBA, /*!< 4 bytes per pixel (1-red, 1-green, 1-blue, 1-alpha) */
+        BGRA, /*!< 4 bytes per pixel (1-blue, 1-green, 1-red, 1-alpha) */
+        RGB565, /*!< 2 bytes per pixel (5 bits red, 6 bits green, 5 bits blue) */
+        RGBA4444, /*!< 2 bytes per pixel (4 bits per red, green, blue and alpha) */
+        ETC2, /*!< compressed RGB, 8 bytes per 4x4 block */
+        ETC2A, /*!< compressed RGBA, 16 bytes per 4x4 block */
+        BC1, /*!< compressed RGB with 1-bit alpha (DXT1), 8 bytes per 4x4 block */
+        BC3, /*!< compressed RGBA (DXT5), 16 bytes per 4x4 block */
+        BC7 /*!< compressed high quality RGBA, 16 bytes per 4x4 block */
     };
+    //! size of a compressed block in pixels (both width and height)
+    static const uint32_t kBlockSize = 4;
     virtual ~Image() = default;
 
     //! return size
@@ -220,12 +267,55 @@ public:
     virtual Format format() const = 0;
     //! check if bilinear filtering is enabled or not
     virtual bool filter() const = 0;
+    //! check if the image has mip levels (see Renderer::makeImage)
+    virtual bool mipmaps() const = 0;
     //! upload bytes to the image
     /*!
+      Compressed formats take (width / 4) * (height / 4) blocks rounded up.
       \throw draw::InvalidArgument if bytes.data is invalid
       \throw draw::InvalidArgument if bytes.count != width * height * (bytes per pixel)
     */
     virtual void upload(Bytes bytes) = 0;
+    //! upload bytes to a rectangular region of the image
+    /*!
+      Only the region is transferred, the image storage is not reallocated.
+      \param region a part of the image in pixels
+      \param bytes pixels of the region, rows go from bottom to top
+      \param stride distance between the starts of two rows in bytes (0 means tightly packed)
+      \throw draw::InvalidArgument if region is empty or outside of the image
+      \throw draw::InvalidArgument if the format is compressed and region is not aligned
+      to Image::kBlockSize (except at the right and top edges) or stride is not zero
+      \throw draw::InvalidArgument if stride is not zero and < region width * (bytes per pixel)
+      \throw draw::InvalidArgument if stride is not a multiple of (bytes per pixel)
+      \throw draw::InvalidArgument if bytes.data is invalid or bytes.count is not enough
+    */
+    virtual void upload(const Rect& region, Bytes bytes, uint32_t stride) = 0;
+    //! upload bytes and share texture memory with images of identical content
+    /*!
+      Images which were uploaded with the same size, format, filter and bytes are drawn
+      from one texture and batched together. A later upload makes a private copy.
+      \throw draw::InvalidArgument if the image is a streaming one
+      \throw draw::InvalidArgument if bytes.data is invalid
+      \throw draw::InvalidArgument if bytes.count != width * height * (bytes per pixel)
+    */
+    virtual void uploadShared(Bytes bytes) = 0;
+    //! check if the image is a streaming one (see Renderer::makeStreamImage)
+    virtual bool stream() const = 0;
+    //! return memory for the next frame of a streaming image
+    /*!
+      Can be called from any thread. Write width * height * (bytes per pixel) bytes
+      and call Image::unlock. The frame is transferred to the image asynchronously
+      by the next Renderer::draw. One frame is written at a time, so producers on
+      several threads get nullptr until the locked frame is unlocked.
+      \return nullptr if a frame is locked or all buffers are busy (try again later)
+      \throw draw::InvalidArgument if the image is not a streaming one
+    */
+    virtual uint8_t* lock() = 0;
+    //! finish writing of a frame obtained by Image::lock
+    /*!
+      \throw draw::InvalidArgument if the image is not locked
+    */
+    virtual void unlock() = 0;
 };
 
 using ImagePtr = SHARED_PTR<Image>;
@@ -292,7 +382,11 @@ public:
 using ShapePtr = SHARED_PTR<Shape>;
 
 //! Set of characters of the same style and size.
-/*! To create an object of this type use Renderer::makeFont function. */
+/*! To create an object of this type use Renderer::makeFont function.
+    Printable ASCII glyphs are rasterized with the font, other glyphs the first
+    time a text shows them. Glyphs no text shows are evicted when space runs out.
+    Glyphs of distance field fonts stay sharp at any Text::letterSize.
+*/
 class Font {
 
 public:
@@ -304,6 +398,8 @@ public:
     virtual const char* filePath() const = 0;
     //! return letter size
     virtual uint32_t letterSize() const = 0;
+    //! return true if glyphs are stored as signed distances to their outlines
+    virtual bool distanceField() const = 0;
 };
 
 using FontPtr = SHARED_PTR<Font>;
@@ -318,7 +414,7 @@ public:
     virtual void font(const FontPtr& font) = 0;
     //! return Font object (initial value is nullptr)
     virtual FontPtr font() const = 0;
-    //! set text string
+    //! set text string (characters the font has no glyph of are skipped)
     virtual void text(const wchar_t* text) = 0;
     //! return text string (initial value is empty string)
     virtual const wchar_t* text() const = 0;
@@ -326,6 +422,11 @@ public:
     virtual void color(Color color) = 0;
     //! return RGBA-color (initial value is 0xFFFFFFFF)
     virtual Color color() const = 0;
+    //! set letter size the glyphs of the font are scaled to (0 means the font letter size)
+    /*! Glyphs of bitmap fonts get blurry when scaled, use distance field fonts instead. */
+    virtual void letterSize(uint32_t size) = 0;
+    //! return letter size (initial value is 0)
+    virtual uint32_t letterSize() const = 0;
     //! Horizontal alignment.
     enum class HorizAlign {
 
@@ -352,6 +453,64 @@ public:
 
 using TextPtr = SHARED_PTR<Text>;
 
+//! Texture memory counters of a renderer (see Renderer::textureBudget).
+struct TextureUsage {
+
+    uint64_t bytes {0}; /*!< texture memory of resident images */
+    uint64_t budget {0}; /*!< current budget (0 means unlimited) */
+    uint32_t evictions {0}; /*!< count of images moved to the backing store */
+    uint32_t restores {0}; /*!< count of images uploaded back from the backing store */
+};
+
+//! Statistics of the latest frame (see Renderer::stats).
+struct FrameStats {
+
+    //! count of latest frames the percentiles are computed over
+    static const uint32_t kWindowSize = 256;
+
+    uint32_t batches {0}; /*!< groups of instances with the same fill mode, order, geometry and image */
+    uint32_t drawCalls {0}; /*!< issued draw calls */
+    uint32_t programBinds {0}; /*!< shader program switches */
+    uint32_t textureBinds {0}; /*!< texture switches */
+    uint32_t bufferBinds {0}; /*!< vertex, index and instance buffer binds */
+    uint32_t instances {0}; /*!< instances uploaded to the instance buffer */
+    uint32_t culledInstances {0}; /*!< instances skipped as they are outside of the screen */
+    uint64_t uploadedBytes {0}; /*!< bytes of uploaded instances and streaming image frames */
+    float transferTime {0.0f}; /*!< CPU time of streaming image transfers in ms */
+    float batchTime {0.0f}; /*!< CPU time of grouping and sorting batches in ms */
+    float uploadTime {0.0f}; /*!< CPU time of culling and uploading instances in ms */
+    float submitTime {0.0f}; /*!< CPU time of state changes and draw calls in ms */
+    float evictTime {0.0f}; /*!< CPU time of texture eviction in ms */
+    float frameTime {0.0f}; /*!< CPU time of the whole Renderer::draw in ms */
+    float frameTimeP50 {0.0f}; /*!< median frame time over the latest frames in ms */
+    float frameTimeP99 {0.0f}; /*!< 99th percentile of frame time over the latest frames in ms */
+    float gpuTime {0.0f}; /*!< GPU time of a frame a few frames ago in ms (see Renderer::gpuTiming) */
+    Span<float> gpuDrawCallTimes {nullptr, 0}; /*!< GPU time of each draw call of that frame in ms */
+};
+
+//! OpenGL function table of a renderer (see draw::makeRenderer).
+enum class Backend {
+    OpenGL, /*!< the OpenGL of the renderer context */
+    Null, /*!< functions doing nothing, so renderers work without a GPU */
+    Counting, /*!< Backend::Null counting calls and bytes per function (see Renderer::glCalls) */
+    Software /*!< Backend::Null with scenes rasterized on the CPU (see Renderer::pixels) */
+};
+
+//! Usage of an OpenGL function counted by Backend::Counting.
+struct GLCalls {
+
+    const char* function {nullptr}; /*!< function name, e.g. "glBufferData" */
+    uint64_t calls {0}; /*!< count of calls */
+    uint64_t bytes {0}; /*!< bytes of buffer and texture data passed to the function */
+};
+
+//! Receiver of pixels read by Renderer::readPixels.
+/*!
+  Pixels are RGBA rows from the bottom to the top and are valid during the call only.
+  The span is empty if the pixel buffer could not be mapped.
+*/
+using PixelsCallback = std::function<void(Image::Bytes pixels, const Size& size)>;
+
 //! Factory and context owner.
 /*! To create an object of this type use draw::makeRenderer function. */
 #ifdef DRAW_NO_EXCEPTIONS
@@ -372,10 +531,38 @@ public:
       \throw draw::InvalidArgument if vertices.count is zero or > Geometry::kMaxVertexCount
       \throw draw::InvalidArgument if indices.data is invalid
       \throw draw::InvalidArgument if indices.count is zero
+      \throw draw::InvalidArgument if an index is not less than vertices.count
       \throw draw::OpenGLOutOfMemory if is not enough memory to create internal OpenGL resources
     */
     virtual GeometryPtr makeGeometry(Geometry::Vertices vertices,
         Geometry::Indices indices, Geometry::Primitive primitive) = 0;
+    //! make static Geometry object sharing memory with geometries of identical content
+    /*!
+      Returns an existing object if a geometry with the same vertices, indices and
+      primitive is alive, so shapes using either of them are batched together.
+      \throw draw::InvalidArgument if vertices.data is invalid
+      \throw draw::InvalidArgument if vertices.count is zero or > Geometry::kMaxVertexCount
+      \throw draw::InvalidArgument if indices.data is invalid
+      \throw draw::InvalidArgument if indices.count is zero
+      \throw draw::InvalidArgument if an index is not less than vertices.count
+      \throw draw::OpenGLOutOfMemory if is not enough memory to create internal OpenGL resources
+    */
+    virtual GeometryPtr makeSharedGeometry(Geometry::Vertices vertices,
+        Geometry::Indices indices, Geometry::Primitive primitive) = 0;
+    //! make dynamic Geometry object with reserved capacity
+    /*!
+      Vertices and indices may be empty. Use Geometry::update to change them later
+      without buffer reallocation.
+      \throw draw::InvalidArgument if vertices.data is invalid and vertices.count is not zero
+      \throw draw::InvalidArgument if vertexCapacity is zero, < vertices.count or > Geometry::kMaxVertexCount
+      \throw draw::InvalidArgument if indices.data is invalid and indices.count is not zero
+      \throw draw::InvalidArgument if indexCapacity is zero or < indices.count
+      \throw draw::InvalidArgument if an index is not less than vertexCapacity
+      \throw draw::OpenGLOutOfMemory if is not enough memory to create internal OpenGL resources
+    */
+    virtual GeometryPtr makeGeometry(Geometry::Vertices vertices,
+        Geometry::Indices indices, Geometry::Primitive primitive,
+        uint32_t vertexCapacity, uint32_t indexCapacity) = 0;
     //! make Image object
     /*!
       \param size
@@ -383,17 +570,82 @@ public:
       \param filter use bilinear filtering or not
       \throw draw::InvalidArgument if size.width is zero or > Image::kMaxSize
       \throw draw::InvalidArgument if size.height is zero or > Image::kMaxSize
+      \throw draw::OpenGLAbsentFeature if format is not supported (see Renderer::supports)
       \throw draw::OpenGLOutOfMemory if is not enough memory to create internal OpenGL resources
     */
     virtual ImagePtr makeImage(const Size& size, Image::Format format, bool filter) = 0;
+    //! make Image object with mip levels
+    /*!
+      Mip levels are regenerated after every upload, so minified images are sampled
+      without aliasing. With filter enabled the sampling is trilinear.
+      \param size
+      \param format
+      \param filter use bilinear filtering or not
+      \param mipmaps make mip levels or not
+      \throw draw::InvalidArgument if size.width is zero or > Image::kMaxSize
+      \throw draw::InvalidArgument if size.height is zero or > Image::kMaxSize
+      \throw draw::InvalidArgument if mipmaps is enabled and format is compressed
+      \throw draw::OpenGLAbsentFeature if format is not supported (see Renderer::supports)
+      \throw draw::OpenGLOutOfMemory if is not enough memory to create internal OpenGL resources
+    */
+    virtual ImagePtr makeImage(const Size& size, Image::Format format, bool filter,
+        bool mipmaps) = 0;
+    //! make streaming Image object
+    /*!
+      Frames are written via Image::lock / Image::unlock from any thread and are
+      transferred through a ring of pixel buffer objects without stalling the renderer.
+      \param size
+      \param format
+      \param filter use bilinear filtering or not
+      \param bufferCount count of frame buffers (2 for double, 3 for triple buffering)
+      \throw draw::InvalidArgument if size.width is zero or > Image::kMaxSize
+      \throw draw::InvalidArgument if size.height is zero or > Image::kMaxSize
+      \throw draw::InvalidArgument if bufferCount < Image::kMinStreamBuffers or > Image::kMaxStreamBuffers
+      \throw draw::OpenGLAbsentFeature if format is not supported (see Renderer::supports)
+      \throw draw::OpenGLOutOfMemory if is not enough memory to create internal OpenGL resources
+    */
+    virtual ImagePtr makeStreamImage(const Size& size, Image::Format format, bool filter,
+        uint32_t bufferCount) = 0;
+    //! check if images of the format can be made
+    /*!
+      Uncompressed formats are always supported. ETC2 formats require
+      ARB_ES3_compatibility, BC1 and BC3 require EXT_texture_compression_s3tc,
+      BC7 requires ARB_texture_compression_bptc.
+    */
+    virtual bool supports(Image::Format format) const = 0;
     //! make Font object
     /*!
+      Fonts made from the same file share it, the file is mapped into memory and
+      parsed once while any of them is alive.
       \throw draw::InvalidArgument if filePath is invalid
       \throw draw::InvalidArgument if letterSize is less than Font::kMinLetterSize
+      \throw draw::InvalidArgument if the alphabet of letterSize does not fit into an Image::kMaxSize atlas
       \throw draw::InvalidFontFile if font file is not exist or corrupted
       \throw draw::IncompleteFontFile if some alphabet's glyphs is not contained in the font file
     */
     virtual FontPtr makeFont(const char* filePath, uint32_t letterSize) = 0;
+    //! make Font object with glyphs stored as signed distance fields if distanceField is true
+    /*!
+      One distance field font serves texts of every letter size (see Text::letterSize),
+      so they are drawn as one batch. Its atlas takes longer to make, the letterSize
+      is the size glyphs are measured and sampled at: strokes thinner than a texel
+      break up when scaled, so thin typefaces need letter sizes of 24 or more.
+      \throw draw::InvalidArgument if filePath is invalid
+      \throw draw::InvalidArgument if letterSize is less than Font::kMinLetterSize
+      \throw draw::InvalidArgument if the alphabet of letterSize does not fit into an Image::kMaxSize atlas
+      \throw draw::InvalidFontFile if font file is not exist or corrupted
+      \throw draw::IncompleteFontFile if some alphabet's glyphs is not contained in the font file
+    */
+    virtual FontPtr makeFont(const char* filePath, uint32_t letterSize,
+        bool distanceField) = 0;
+    //! set a directory of font atlases cached between runs (initial value is nullptr, no cache)
+    /*!
+      Renderer::makeFont stores the alphabet atlas of a font file and letter size in
+      the directory and later maps it into memory instead of rasterizing the alphabet
+      again. Cache files are named after font files and letter sizes and are rewritten
+      when the font file changes. The directory must exist, failed writes are ignored.
+    */
+    virtual void fontCache(const char* directory) = 0;
     //! make Shape object with rectangle Geometry
     virtual ShapePtr makeRect() = 0;
     //! make Shape object
@@ -402,11 +654,66 @@ public:
     virtual TextPtr makeText() = 0;
     //! clear the screen and repaint all visible objects
     /*!
+      Objects outside of the screen are skipped.
       \return drawn objects count
     */
     virtual uint32_t draw(Color clear) = 0;
     //! set a new screen size
     virtual void resize(const Size& size) = 0;
+    //! set a texture memory budget in bytes (initial value is 0, unlimited)
+    /*!
+      When resident images exceed the budget, the textures of the least recently drawn
+      ones are freed at the end of Renderer::draw and uploaded back when they are drawn
+      again. Images keep a CPU backing store of their uploads for that, so eviction
+      never reads textures back. Streaming images are never evicted.
+    */
+    virtual void textureBudget(uint64_t bytes) = 0;
+    //! return texture memory counters
+    virtual TextureUsage textureUsage() const = 0;
+    //! return statistics of the latest Renderer::draw
+    virtual FrameStats stats() const = 0;
+    //! enable/disable GPU timing of frames (initially disabled)
+    /*!
+      Results arrive asynchronously with a few frames latency, so the GPU is never
+      waited for, and are returned by Renderer::stats. Without ARB_timer_query
+      the timing stays disabled.
+      \param enable
+      \param drawCalls measure every draw call besides the whole frame
+      \return true if the timing is enabled
+    */
+    virtual bool gpuTiming(bool enable, bool drawCalls) = 0;
+    //! return counters of all OpenGL functions since the renderer was made
+    /*!
+      Counters are collected by Backend::Counting only, other backends return
+      an empty span.
+    */
+    virtual Span<GLCalls> glCalls() const = 0;
+    //! return pixels of the latest Renderer::draw of Backend::Software
+    /*!
+      The frame is split into tiles rasterized with AGG on all CPU cores. Pixels are
+      RGBA rows from the bottom to the top, like glReadPixels returns them. Compressed
+      image formats are not supported and mipmaps are not sampled. Other backends
+      return an empty span.
+    */
+    virtual Image::Bytes pixels() const = 0;
+    //! enable/disable drawing into an offscreen framebuffer (initially disabled)
+    /*!
+      Frames get the size set by Renderer::resize and are not shown on the screen,
+      use Renderer::readPixels to get them. Requires OpenGL 3.0 or ARB_framebuffer_object.
+      \return true if offscreen drawing is enabled
+    */
+    virtual bool offscreen(bool enable) = 0;
+    //! read pixels of the latest Renderer::draw without waiting for the GPU
+    /*!
+      The frame is copied to a pixel buffer and the callback is called by one of the
+      next Renderer::draw once a fence (ARB_sync) tells the copy is done, or two frames
+      later without fences. Callbacks are called in the order of requests. Without
+      ARB_pixel_buffer_object the pixels are read at once, stalling the pipeline.
+      Read the screen before swapping its buffers.
+    */
+    virtual void readPixels(PixelsCallback callback) = 0;
+    //! wait for all pending Renderer::readPixels and call their callbacks
+    virtual void finishReads() = 0;
 };
 
 using RendererPtr = SHARED_PTR<Renderer>;
@@ -437,10 +744,53 @@ using ContextPtr = std::unique_ptr<Context>;
 /*!
   \param context It's recommended to move ownership of the context immediately to
   the renderer: makeRenderer(std::move(make_unique<ContextImpl>())).
+  \param backend Backend::Null, Backend::Counting and Backend::Software never call
+  OpenGL, so the context is optional for them
   \throw draw::InvalidArgument if context is invalid
   \throw draw::OpenGLAbsentFeature if OpenGL 2.0 or ARB_draw_instanced are not supported
   \throw draw::OpenGLOutOfMemory if is not enough memory to create internal OpenGL resources
 */
-RendererPtr makeRenderer(ContextPtr context);
+RendererPtr makeRenderer(ContextPtr context, Backend backend = Backend::OpenGL);
+
+//! Receiver of trace events (see draw::setTraceSink).
+/*!
+  Events are emitted by the thread doing the work, so implementations must be thread safe.
+*/
+class TraceSink {
+
+public:
+    virtual ~TraceSink() = default;
+    //! a scope has begun
+    /*!
+      \param name static string with the scope name
+      \param timestamp microseconds of a monotonic clock
+    */
+    virtual void begin(const char* name, uint64_t timestamp) = 0;
+    //! the latest scope begun in the calling thread has ended
+    virtual void end(const char* name, uint64_t timestamp) = 0;
+};
+
+using TraceSinkPtr = SHARED_PTR<TraceSink>;
+
+//! install a trace sink for all renderers (initially none, nullptr removes the sink)
+/*!
+  Traced scopes are Renderer::draw with its phases, Renderer::makeGeometry,
+  Image::upload, font file loading and font atlas generation. Without a sink the tracing costs
+  one atomic load per scope.
+*/
+void setTraceSink(TraceSinkPtr sink);
+
+//! make a sink writing Chrome trace event JSON (chrome://tracing, Perfetto)
+#ifdef DRAW_NO_EXCEPTIONS
+/*!
+  NOTE: exceptions are disabled. 'Exceptions' section lists expected errors
+  which you can obtain via draw::getLastError.
+*/
+#endif
+/*!
+  The file is completed when the sink is destroyed.
+  \throw draw::InvalidArgument if filePath is invalid or the file can't be created
+*/
+TraceSinkPtr makeChromeTraceSink(const char* filePath);
 
 } // namespace draw
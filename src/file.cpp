@@ -0,0 +1,187 @@
+#include "file.h"
+#include <cstdio>
+#include <cstdlib>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace draw {
+
+MappedFile::~MappedFile() {
+
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filePath) {
+
+    close();
+    file_ = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_)
+        data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+        close();
+        return false;
+    }
+    size_ = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_)
+        CloseHandle(file_);
+    data_ = nullptr;
+    mapping_ = file_ = nullptr;
+    size_ = 0;
+}
+
+static bool replaceFile(const std::string& from, const std::string& to) {
+
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+TempDirectory::TempDirectory() {
+
+    for (uint32_t i = 0; i < 100 && path_.empty(); ++i) {
+        auto path = "draw_" + std::to_string(GetCurrentProcessId()) + "_" + std::to_string(i);
+        if (CreateDirectoryA(path.c_str(), nullptr))
+            path_ = path;
+    }
+}
+
+std::vector<std::string> TempDirectory::files() const {
+
+    std::vector<std::string> names;
+    WIN32_FIND_DATAA data;
+    auto find = path_.empty() ? INVALID_HANDLE_VALUE :
+        FindFirstFileA((path_ + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return names;
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            names.push_back(data.cFileName);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+    return names;
+}
+
+static void removeDirectory(const std::string& path) {
+
+    RemoveDirectoryA(path.c_str());
+}
+
+#else
+
+bool MappedFile::open(const std::string& filePath) {
+
+    close();
+    auto file = ::open(filePath.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        auto data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data != MAP_FAILED) {
+            data_ = static_cast<const uint8_t*>(data);
+            size_ = (size_t)info.st_size;
+        }
+    }
+    // the mapping stays valid without the descriptor
+    ::close(file);
+    return data_ != nullptr;
+}
+
+void MappedFile::close() {
+
+    if (data_)
+        munmap(const_cast<uint8_t*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+static bool replaceFile(const std::string& from, const std::string& to) {
+
+    return std::rename(from.c_str(), to.c_str()) == 0;
+}
+
+TempDirectory::TempDirectory() {
+
+    char path[] = "draw_XXXXXX";
+    if (mkdtemp(path))
+        path_ = path;
+}
+
+std::vector<std::string> TempDirectory::files() const {
+
+    std::vector<std::string> names;
+    auto directory = path_.empty() ? nullptr : opendir(path_.c_str());
+    if (!directory)
+        return names;
+    while (auto entry = readdir(directory)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            names.push_back(name);
+    }
+    closedir(directory);
+    return names;
+}
+
+static void removeDirectory(const std::string& path) {
+
+    rmdir(path.c_str());
+}
+
+#endif
+
+bool writeFile(const std::string& filePath, const Image::Bytes* parts, size_t partCount) {
+
+    auto temporaryPath = filePath + ".tmp";
+    auto file = fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+        return false;
+    auto written = true;
+    for (size_t i = 0; i < partCount && written; ++i)
+        written = fwrite(parts[i].ptr, 1, parts[i].count, file) == parts[i].count;
+    written = fclose(file) == 0 && written;
+    if (!written || !replaceFile(temporaryPath, filePath)) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+TempDirectory::~TempDirectory() {
+
+    if (path_.empty())
+        return;
+    for (const auto& name : files())
+        std::remove((path_ + "/" + name).c_str());
+    removeDirectory(path_);
+}
+
+} // namespace draw
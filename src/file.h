@@ -0,0 +1,54 @@
+#pragma once
+#include <draw.h>
+#include <string>
+#include <vector>
+
+namespace draw {
+
+// read-only view of a whole file mapped into memory
+class MappedFile final {
+
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    bool open(const std::string& filePath);
+    void close();
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ {nullptr};
+    size_t size_ {0};
+#ifdef _WIN32
+    void* file_ {nullptr};
+    void* mapping_ {nullptr};
+#endif
+};
+
+// writes a temporary file renamed at the end, so readers never see a partial one
+bool writeFile(const std::string& filePath, const Image::Bytes* parts, size_t partCount);
+
+// directory with a unique name in the working directory, removed with its files on
+// destruction, used by tests and benchmarks of file caches
+class TempDirectory final {
+
+public:
+    TempDirectory();
+    ~TempDirectory();
+
+    TempDirectory(const TempDirectory&) = delete;
+    TempDirectory& operator = (const TempDirectory&) = delete;
+
+    // empty if the directory can't be made
+    const std::string& path() const { return path_; }
+    std::vector<std::string> files() const;
+
+private:
+    std::string path_;
+};
+
+} // namespace draw
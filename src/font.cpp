@@ -1,7 +1,13 @@
 #include "font.h"
 #include <error.h>
+#include <file.h>
 #include <renderer.h>
+#include <trace.h>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <workers.h>
 #include <agg_pixfmt_gray.h>
 #include <agg_renderer_scanline.h>
 #include <agg_font_cache_manager.h>
@@ -38,6 +44,8 @@ public:
     Scanline& scanline() { return scanline_; }
     const uint8_t* data() { return buffer_.data(); }
     size_t size() const { return buffer_.size(); }
+    // the renderer can't be used after it gives its pixels away
+    std::vector<uint8_t> takeData() { return std::move(buffer_); }
 
 private:
     std::vector<uint8_t> buffer_;
@@ -55,8 +63,14 @@ public:
     Context(Context &) = delete;
     Context &operator=(const Context &) = delete;
 
-    bool loadFont(const std::string &filePath, uint32_t letterSize);
-    const Glyph* getGlyph(wchar_t character);
+    // parses the font file without setting errors, so any thread may call it
+    bool openFont(const FontFace& face);
+    void letterSize(uint32_t letterSize);
+    // returns nullptr if FreeType fails to rasterize the character
+    const Glyph* rasterize(wchar_t character);
+    // returns nullptr if the glyph is absent from the font or blank
+    const Glyph* getGlyph(wchar_t character) { return visible(rasterize(character)); }
+    static const Glyph* visible(const Glyph* glyph);
     void renderGlyph(Renderer& renderer, const Glyph* glyph, double x, double y);
 
 private:
@@ -81,34 +95,39 @@ const std::wstring& getAlphabet() {
     return alphabet;
 }
 
-bool Context::loadFont(const std::string &filePath, uint32_t letterSize) {
+bool Context::openFont(const FontFace& face) {
 
     ASSERT(engine_.last_error() == 0);
 
-    if (!engine_.load_font(filePath.c_str(), 0, agg::glyph_ren_native_gray8)) {
-        setError(InvalidFontFile);
+    const auto& file = face.file();
+    if (!engine_.load_font(face.filePath().c_str(), 0, agg::glyph_ren_native_gray8,
+        reinterpret_cast<const char*>(file.data()), (long)file.size())) {
         return false;
     }
     engine_.hinting(false);
+    return true;
+}
+
+void Context::letterSize(uint32_t letterSize) {
+
     if (engine_.height() != letterSize ||
         engine_.width() != letterSize) {
         engine_.height(letterSize);
         engine_.width(letterSize);
     }
-    for (auto c : getAlphabet()) {
-        manager_.reset_last_glyph();
-        if (!manager_.glyph((uint32_t)c)) {
-            setError(IncompleteFontFile);
-            return false;
-        }
-    }
-    return true;
 }
 
-const Glyph* Context::getGlyph(wchar_t character) {
+const Glyph* Context::rasterize(wchar_t character) {
 
     manager_.reset_last_glyph();
-    auto glyph = manager_.glyph((uint32_t)character);
+    return manager_.glyph((uint32_t)character);
+}
+
+const Glyph* Context::visible(const Glyph* glyph) {
+
+    // characters out of the font map to the .notdef glyph
+    if (!glyph || glyph->glyph_index == 0)
+        return nullptr;
     const auto& b = glyph->bounds;
     if (b.x1 != 0 || b.x2 != 0 || b.y1 != 0 || b.y2 != 0) {
         return glyph;
@@ -124,70 +143,752 @@ void Context::renderGlyph(Renderer& renderer, const Glyph* glyph, double x, doub
         manager_.gray8_scanline(), renderer.scanline());
 }
 
-ImagePtr generateAtlas(RendererImpl& rendererImpl, const std::string& filePath,
-    uint32_t letterSize, Letters& letters) {
+// rows of cells of the same height filled from the bottom left corner
+class ShelfPacker {
+
+public:
+    ShelfPacker(uint32_t width, uint32_t height, uint32_t rowHeight) :
+        width_(width), height_(height), rowHeight_(rowHeight) {}
+
+    bool insert(uint32_t width, Point& position) {
+
+        if (width > width_)
+            return false;
+        if (x_ + width > width_) {
+            x_ = 0;
+            y_ += rowHeight_;
+        }
+        if (y_ + rowHeight_ > height_)
+            return false;
+        position = Point((int32_t)x_, (int32_t)y_);
+        x_ += width;
+        return true;
+    }
+    uint32_t usedHeight() const { return x_ == 0 ? y_ : y_ + rowHeight_; }
+
+private:
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t rowHeight_;
+    uint32_t x_ {0};
+    uint32_t y_ {0};
+};
+
+inline uint32_t nextPowerOfTwo(uint32_t value) {
+
+    uint32_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+// the smallest power of two atlas the cells fit in, the squarest one of equal areas
+Size atlasSize(const std::vector<uint32_t>& cellWidths, uint32_t cellHeight) {
+
+    static const uint32_t kMinAtlasSize = 16;
+
+    Size best(0, 0);
+    for (auto width = kMinAtlasSize; width <= Image::kMaxSize; width <<= 1) {
+        ShelfPacker packer(width, Image::kMaxSize, cellHeight);
+        Point position;
+        auto fits = std::all_of(std::begin(cellWidths), std::end(cellWidths),
+            [&](uint32_t cellWidth) { return packer.insert(cellWidth, position); });
+        if (!fits)
+            continue;
+
+        Size size(width, nextPowerOfTwo(std::max(packer.usedHeight(), kMinAtlasSize)));
+        auto area = (uint64_t)size.width * size.height;
+        auto bestArea = (uint64_t)best.width * best.height;
+        if (bestArea == 0 || area < bestArea ||
+            (area == bestArea && std::max(size.width, size.height) <
+                std::max(best.width, best.height))) {
+            best = size;
+        }
+    }
+    return best;
+}
+
+static const auto kBorderWidth = 1u;
+static const auto kSpaceFactor = 0.7f;
+
+inline double letterWidth(wchar_t c, const Glyph* glyph) {
+
+    return (c == kSpaceSymbol ? kSpaceFactor : 1.0f) *
+        std::max(glyph->advance_x, (double)(glyph->bounds.x2 - glyph->bounds.x1));
+}
+
+// texels of a letter in the cell at x, y, without borders wider than the bitmap ones,
+// so letters of all fonts have the same sizes
+inline Rect letterRect(int32_t x, int32_t y, double width, const AtlasMetrics& metrics) {
+
+    auto inset = (int32_t)(metrics.border - kBorderWidth);
+    auto left = x + (int32_t)metrics.border;
+    return Rect(left, y + inset, left + (int32_t)(width + 0.5),
+        y + (int32_t)metrics.lineHeight - inset);
+}
+
+// threads pay off for large glyphs only, small alphabets are rasterized
+// faster than the threads load their fonts
+static const uint64_t kPixelsPerThread = 32 * 64 * 64;
+
+inline uint32_t rasterThreadCount(size_t glyphCount, uint32_t letterSize) {
+
+    auto count = (uint64_t)glyphCount * letterSize * letterSize / kPixelsPerThread;
+    return (uint32_t)std::max<uint64_t>(1, std::min<uint64_t>(count, hardwareThreads()));
+}
+
+// runs the job on the worker threads, each with its own context of the face,
+// shares of threads which failed to parse the face are done by the context of thread 0
+template <typename Job>
+bool runThreads(FontFace& face, uint32_t threadCount, uint32_t letterSize, Job&& job) {
+
+    auto* context = face.context(letterSize);
+    if (!context)
+        return false;
+    std::vector<uint8_t> failed(threadCount, 0);
+    face.workers().run(threadCount, [&](uint32_t thread) {
+        auto* threadContext = thread == 0 ? context : face.context(letterSize, thread);
+        if (threadContext)
+            job(*threadContext, thread);
+        else
+            failed[thread] = 1;
+    });
+    for (uint32_t i = 1; i < threadCount; ++i) {
+        if (failed[i])
+            job(*context, i);
+    }
+    return true;
+}
+
+// glyphs of distance field fonts are rendered kDistanceScale times larger, texels
+// store signed distances to their outlines, 0.5 on the outline and
+// 0 and 1 a spread away from it
+static const uint32_t kDistanceScale = 4;
+
+inline uint32_t distanceSpread(uint32_t letterSize) {
+
+    return std::max(2u, letterSize / 8);
+}
+
+// squared distances to the nearest zero of the samples (Felzenszwalb and Huttenlocher)
+void distanceTransform(float* samples, uint32_t count, uint32_t stride,
+    std::vector<float>& distances, std::vector<uint32_t>& parabolas,
+    std::vector<float>& bounds) {
+
+    static const auto kInfinity = 1e20f;
+
+    distances.resize(count);
+    parabolas.resize(count);
+    bounds.resize(count + 1);
+    auto f = [samples, stride](uint32_t i) { return samples[(size_t)i * stride]; };
+
+    uint32_t k = 0;
+    parabolas[0] = 0;
+    bounds[0] = -kInfinity;
+    bounds[1] = kInfinity;
+    for (uint32_t q = 1; q < count; ++q) {
+        float s;
+        for (;;) {
+            auto p = parabolas[k];
+            s = ((f(q) + (float)q * q) - (f(p) + (float)p * p)) / (2.0f * q - 2.0f * p);
+            if (s > bounds[k] || k == 0)
+                break;
+            --k;
+        }
+        if (s <= bounds[k]) {
+            parabolas[k] = q;
+            bounds[k + 1] = kInfinity;
+            continue;
+        }
+        ++k;
+        parabolas[k] = q;
+        bounds[k] = s;
+        bounds[k + 1] = kInfinity;
+    }
+    k = 0;
+    for (uint32_t q = 0; q < count; ++q) {
+        while (bounds[k + 1] < q)
+            ++k;
+        auto p = parabolas[k];
+        distances[q] = ((float)q - p) * ((float)q - p) + f(p);
+    }
+    for (uint32_t q = 0; q < count; ++q)
+        samples[(size_t)q * stride] = distances[q];
+}
+
+// distances to the nearest pixels of the other side of the outline
+class DistanceField {
+
+public:
+    void compute(const uint8_t* coverage, uint32_t width, uint32_t height) {
+
+        static const auto kInfinity = 1e20f;
+
+        width_ = width;
+        outside_.resize((size_t)width * height);
+        inside_.resize(outside_.size());
+        for (size_t i = 0; i < outside_.size(); ++i) {
+            auto in = coverage[i] >= 128;
+            outside_[i] = in ? kInfinity : 0.0f;
+            inside_[i] = in ? 0.0f : kInfinity;
+        }
+        for (auto* grid : {&outside_, &inside_}) {
+            for (uint32_t x = 0; x < width; ++x)
+                distanceTransform(grid->data() + x, height, width, distances_, parabolas_, bounds_);
+            for (uint32_t y = 0; y < height; ++y)
+                distanceTransform(grid->data() + (size_t)y * width, width, 1, distances_,
+                    parabolas_, bounds_);
+        }
+    }
+
+    // positive inside of the outline, in pixels
+    float signedDistance(uint32_t x, uint32_t y) const {
+
+        auto i = (size_t)y * width_ + x;
+        return outside_[i] > 0.0f ? std::sqrt(outside_[i]) - 0.5f :
+            0.5f - std::sqrt(inside_[i]);
+    }
+
+private:
+    uint32_t width_ {0};
+    std::vector<float> outside_;
+    std::vector<float> inside_;
+    std::vector<float> distances_;
+    std::vector<uint32_t> parabolas_;
+    std::vector<float> bounds_;
+};
 
-    static const auto kBorderWidth = 1u, kBorderSize = kBorderWidth * 2;
-    static const auto kSpaceFactor = 0.7f;
+// renders the large glyph into a width x height cell of texels with the origin at x, y
+void renderDistance(Context& context, const Glyph* glyph, uint32_t width, uint32_t height,
+    int32_t x, int32_t y, uint32_t spread, DistanceField& field, uint8_t* cell,
+    uint32_t stride) {
+
+    const auto scale = kDistanceScale;
+    Renderer renderer(width * scale, height * scale);
+    context.renderGlyph(renderer, glyph, x * (double)scale, y * (double)scale);
+    field.compute(renderer.data(), width * scale, height * scale);
+
+    // the texel center lies between the middle pixels of its block
+    auto middle = scale / 2;
+    for (uint32_t row = 0; row < height; ++row) {
+        for (uint32_t column = 0; column < width; ++column) {
+            auto left = column * scale + middle - 1, bottom = row * scale + middle - 1;
+            auto distance = (field.signedDistance(left, bottom) +
+                field.signedDistance(left + 1, bottom) +
+                field.signedDistance(left, bottom + 1) +
+                field.signedDistance(left + 1, bottom + 1)) / (4.0f * scale);
+            auto value = 0.5f + distance / (2.0f * spread);
+            cell[(size_t)row * stride + column] =
+                (uint8_t)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
 
-    Context context;
-    if (!context.loadFont(filePath, letterSize))
-        return ImagePtr();
+bool generateAtlas(FontFace& face, uint32_t letterSize, bool distanceField, Letters& letters,
+    AtlasMetrics& metrics, std::vector<uint8_t>& pixels) {
+
+    TraceScope trace("Font::generateAtlas");
+
+    // the contexts of the face keep their glyphs in caches until the atlas is drawn
+    const auto& alphabet = getAlphabet();
+    std::vector<const Glyph*> glyphs(alphabet.size(), nullptr);
+    auto threadCount = rasterThreadCount(alphabet.size(),
+        distanceField ? letterSize * kDistanceScale : letterSize);
+    auto rasterized = runThreads(face, threadCount, letterSize,
+        [&](Context& threadContext, size_t first) {
+            for (auto i = first; i < alphabet.size(); i += threadCount)
+                glyphs[i] = threadContext.rasterize(alphabet[i]);
+        });
+    if (!rasterized)
+        return false;
+    for (size_t i = 0; i < alphabet.size(); ++i) {
+        if (!glyphs[i]) {
+            setError(IncompleteFontFile);
+            return false;
+        }
+        glyphs[i] = Context::visible(glyphs[i]);
+    }
 
-    auto width = 0, height = 0, heightOffset = 0;
-    auto x = (double)kBorderWidth, y = 0.0;
+    // the packing goes in the alphabet order, so it doesn't depend on threads
+    auto border = distanceField ? distanceSpread(letterSize) : kBorderWidth;
+    auto height = 0, heightOffset = 0;
+    std::vector<double> widths(alphabet.size());
+    std::vector<uint32_t> cellWidths;
+    cellWidths.reserve(alphabet.size());
 
-    for (auto c : getAlphabet()) {
-        auto glyph = context.getGlyph(c);
+    for (size_t i = 0; i < alphabet.size(); ++i) {
+        auto c = alphabet[i];
+        auto glyph = glyphs[i];
         if (!glyph)
             continue;
         if (c != kSpaceSymbol) {
             height = std::max<int32_t>(height, glyph->bounds.y2 - glyph->bounds.y1);
             heightOffset = std::min(heightOffset, glyph->bounds.y1);
         }
-        x += (c == kSpaceSymbol ? kSpaceFactor : 1.0f) * glyph->advance_x + kBorderSize;
+        widths[i] = letterWidth(c, glyph);
+        cellWidths.push_back((uint32_t)ceil(widths[i]) + border * 2);
+    }
+    // every cell spans the whole line height, so cells are packed into rows
+    height += -heightOffset + border * 2;
+    auto size = atlasSize(cellWidths, (uint32_t)height);
+    if (size.width == 0) {
+        setError(InvalidArgument);
+        return false;
     }
-    width = (int32_t)ceil(x);
-    height += -heightOffset + kBorderSize;
-    x = kBorderWidth;
-    y = -heightOffset + kBorderWidth;
+    metrics.size = size;
+    metrics.lineHeight = (uint32_t)height;
+    metrics.baseline = -heightOffset + (int32_t)border;
+    metrics.border = border;
 
     letters.clear();
-    Renderer renderer((uint32_t)width, (uint32_t)height);
-
-    for (auto c : getAlphabet()) {
-        auto glyph = context.getGlyph(c);
-        if (!glyph)
+    std::vector<Point> cells(alphabet.size());
+    ShelfPacker packer(size.width, size.height, (uint32_t)height);
+    for (size_t i = 0; i < alphabet.size(); ++i) {
+        auto c = alphabet[i];
+        if (!glyphs[i])
             continue;
-        if (c != kSpaceSymbol)
-            context.renderGlyph(renderer, glyph, x, y);
-        auto w = (c == kSpaceSymbol ? kSpaceFactor : 1.0f) *
-             std::max(glyph->advance_x, (double)(glyph->bounds.x2 - glyph->bounds.x1));
-        letters[c] = Rect((int32_t)x, 0, (int32_t)(x + w), height);
-        x += w + kBorderSize;
+        auto& cell = cells[i];
+        packer.insert((uint32_t)ceil(widths[i]) + border * 2, cell);
+        letters.add(c).rect = letterRect(cell.x, cell.y, widths[i], metrics);
+    }
+
+    auto& context = *face.context(letterSize);
+    if (!distanceField) {
+        Renderer renderer(size.width, size.height);
+        for (size_t i = 0; i < alphabet.size(); ++i) {
+            if (glyphs[i] && alphabet[i] != kSpaceSymbol) {
+                context.renderGlyph(renderer, glyphs[i], cells[i].x + (int32_t)border,
+                    cells[i].y + metrics.baseline);
+            }
+        }
+        pixels = renderer.takeData();
+        return true;
+    }
+
+    // cells don't overlap, so every thread writes the distances of its glyphs at once
+    pixels.assign((size_t)size.width * size.height, 0);
+    return runThreads(face, threadCount, letterSize * kDistanceScale,
+        [&](Context& threadContext, size_t first) {
+            DistanceField field;
+            for (auto i = first; i < alphabet.size(); i += threadCount) {
+                auto c = alphabet[i];
+                auto* glyph = glyphs[i] && c != kSpaceSymbol ?
+                    threadContext.getGlyph(c) : nullptr;
+                if (!glyph)
+                    continue;
+                const auto& cell = cells[i];
+                renderDistance(threadContext, glyph, (uint32_t)ceil(widths[i]) + border * 2,
+                    metrics.lineHeight, (int32_t)border, metrics.baseline, border, field,
+                    pixels.data() + (size_t)cell.y * size.width + cell.x, size.width);
+            }
+        });
+}
+
+// cached atlases are stored in the native byte order, cache files of other
+// versions, fonts, alphabets or platforms are rejected by their headers
+static const uint32_t kCacheMagic = 0x41465244; // DRFA
+static const uint32_t kCacheVersion = 2;
+
+struct CacheHeader {
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t width;
+    uint32_t height;
+    uint32_t lineHeight;
+    int32_t baseline;
+    uint32_t letterCount;
+    uint32_t border;
+};
+
+struct CacheLetter {
+
+    uint32_t code;
+    int32_t left, bottom, right, top;
+};
+
+// the hash of the whole path keeps atlases of equally named fonts of other
+// directories apart
+std::string cachePath(const std::string& directory, const std::string& filePath,
+    uint32_t letterSize, bool distanceField) {
+
+    char pathHash[17];
+    snprintf(pathHash, sizeof(pathHash), "%016llx",
+        (unsigned long long)hash(filePath.data(), filePath.size()));
+    auto name = filePath.substr(filePath.find_last_of("/\\") + 1);
+    auto path = directory;
+    if (!path.empty() && path.back() != '/' && path.back() != '\\')
+        path += '/';
+    return path + name + "." + pathHash + "." + std::to_string(letterSize) +
+        (distanceField ? ".sdf.atlas" : ".atlas");
+}
+
+uint64_t cacheKey(uint64_t fileHash, uint32_t letterSize, bool distanceField) {
+
+    const auto& alphabet = getAlphabet();
+    const uint32_t params[] = {kCacheVersion, letterSize, distanceField ? kDistanceScale : 0};
+    auto key = hash(params, sizeof(params), fileHash);
+    return hash(alphabet.data(), alphabet.size() * sizeof(wchar_t), key);
+}
+
+bool readAtlas(const MappedFile& file, uint64_t key, Letters& letters, AtlasMetrics& metrics,
+    Image::Bytes& pixels) {
+
+    CacheHeader header;
+    if (file.size() < sizeof(header))
+        return false;
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != kCacheMagic || header.version != kCacheVersion || header.key != key ||
+        header.width == 0 || header.width > Image::kMaxSize ||
+        header.height == 0 || header.height > Image::kMaxSize ||
+        header.lineHeight == 0 || header.lineHeight > header.height ||
+        header.border < kBorderWidth || header.border * 2 >= header.lineHeight) {
+        return false;
     }
-    auto atlas = rendererImpl.makeImage(
-        {(uint32_t)width, (uint32_t)height}, Image::Format::A, true);
-    atlas->upload(Image::Bytes(renderer.data(), renderer.size()));
-    return atlas;
+    auto lettersSize = (size_t)header.letterCount * sizeof(CacheLetter);
+    auto pixelsSize = (size_t)header.width * header.height;
+    if (file.size() != sizeof(header) + lettersSize + pixelsSize)
+        return false;
+
+    letters.clear();
+    auto data = file.data() + sizeof(header);
+    for (uint32_t i = 0; i < header.letterCount; ++i, data += sizeof(CacheLetter)) {
+        CacheLetter letter;
+        memcpy(&letter, data, sizeof(letter));
+        letters.add((wchar_t)letter.code).rect =
+            Rect(letter.left, letter.bottom, letter.right, letter.top);
+    }
+    metrics.size = Size(header.width, header.height);
+    metrics.lineHeight = header.lineHeight;
+    metrics.baseline = header.baseline;
+    metrics.border = header.border;
+    pixels = Image::Bytes(data, (uint32_t)pixelsSize);
+    return true;
+}
+
+void writeAtlas(const std::string& filePath, uint64_t key, const Letters& letters,
+    const AtlasMetrics& metrics, Image::Bytes pixels) {
+
+    TraceScope trace("Font::writeAtlas");
+    CacheHeader header = {kCacheMagic, kCacheVersion, key, metrics.size.width,
+        metrics.size.height, metrics.lineHeight, metrics.baseline,
+        (uint32_t)letters.size(), metrics.border};
+    std::vector<CacheLetter> cacheLetters;
+    cacheLetters.reserve(letters.size());
+    letters.forEach([&cacheLetters](wchar_t c, const Letter& letter) {
+        const auto& rect = letter.rect;
+        cacheLetters.push_back({(uint32_t)c, rect.left, rect.bottom, rect.right, rect.top});
+    });
+    const Image::Bytes parts[] = {
+        Image::Bytes(reinterpret_cast<const uint8_t*>(&header), sizeof(header)),
+        Image::Bytes(reinterpret_cast<const uint8_t*>(cacheLetters.data()),
+            (uint32_t)(cacheLetters.size() * sizeof(CacheLetter))),
+        pixels
+    };
+    // the cache is an optimization only, fonts work without it
+    writeFile(filePath, parts, sizeof(parts) / sizeof(parts[0]));
 }
 
 } // namespace details
 
-FontImpl::FontImpl(RendererImpl& renderer, const char* filePath, uint32_t letterSize) :
+Letters::Letters() :
+    blocks_(kBlockCount) {
+
+    blocks_[0] = make_unique<Block>();
+}
+
+Letter& Letters::add(wchar_t c) {
+
+    auto code = (uint32_t)c;
+    Letter* letter = nullptr;
+    if (code < kBlockCount * kBlockSize) {
+        auto& block = blocks_[code / kBlockSize];
+        if (!block)
+            block = make_unique<Block>();
+        letter = &(*block)[code % kBlockSize];
+    }
+    else {
+        letter = &others_[c];
+    }
+    if (!letter->added) {
+        letter->added = true;
+        ++size_;
+    }
+    return *letter;
+}
+
+void Letters::erase(wchar_t c) {
+
+    auto* letter = find(c);
+    if (!letter)
+        return;
+    auto code = (uint32_t)c;
+    if (code < kBlockCount * kBlockSize)
+        *letter = Letter();
+    else
+        others_.erase(c);
+    --size_;
+}
+
+void Letters::clear() {
+
+    // allocated blocks are kept for the letters added next
+    for (auto& block : blocks_) {
+        if (block)
+            block->fill(Letter());
+    }
+    others_.clear();
+    size_ = 0;
+}
+
+Letter* Letters::findOther(wchar_t c) {
+
+    auto it = others_.find(c);
+    return it != others_.end() ? &it->second : nullptr;
+}
+
+FontFace::FontFace(RendererImpl& renderer, const std::string& filePath) :
+    renderer_(renderer),
+    filePath_(filePath) {
+}
+
+FontFace::~FontFace() {
+
+    renderer_.releaseFontFace(filePath_, this);
+}
+
+bool FontFace::init() {
+
+    TraceScope trace("Font::loadFace");
+    if (!file_.open(filePath_)) {
+        setError(InvalidFontFile);
+        return false;
+    }
+    return true;
+}
+
+uint64_t FontFace::hash() {
+
+    if (!hashed_) {
+        TraceScope trace("Font::hashFace");
+        hash_ = draw::hash(file_.data(), file_.size());
+        hashed_ = true;
+    }
+    return hash_;
+}
+
+details::Context* FontFace::context(uint32_t letterSize, uint32_t thread) {
+
+    // worker threads parse the face at once and only touch their own slots,
+    // the slots are made before any of them starts
+    if (contexts_.empty()) {
+        contexts_.resize(workers().threadCount());
+        invalidContexts_.assign(contexts_.size(), 0);
+    }
+    auto& context = contexts_[thread];
+    if (!context) {
+        if (invalidContexts_[thread])
+            return nullptr;
+        TraceScope trace("Font::parseFace");
+        auto newContext = make_unique<details::Context>();
+        if (!newContext->openFont(*this)) {
+            // errors are reported on the calling thread only
+            invalidContexts_[thread] = 1;
+            if (thread == 0)
+                setError(InvalidFontFile);
+            return nullptr;
+        }
+        context = std::move(newContext);
+    }
+    context->letterSize(letterSize);
+    return context.get();
+}
+
+WorkerPool& FontFace::workers() {
+
+    return renderer_.workers();
+}
+
+FontImpl::FontImpl(RendererImpl& renderer, const char* filePath, uint32_t letterSize,
+    bool distanceField) :
     renderer_(renderer),
     filePath_(filePath),
-    letterSize_(letterSize) {
+    letterSize_(letterSize),
+    distanceField_(distanceField) {
 }
 
+FontImpl::~FontImpl() = default;
+
 bool FontImpl::init() {
 
     if (letterSize_ < kMinLetterSize) {
         setError(InvalidArgument);
         return false;
     }
-    atlas_ = details::generateAtlas(renderer_, filePath_, letterSize_, letters_);
-    return atlas_ != nullptr;
+    face_ = renderer_.makeFontFace(filePath_);
+    if (!face_)
+        return false;
+
+    AtlasMetrics metrics;
+    const auto& cacheDirectory = renderer_.fontCache();
+    std::string cachePath;
+    uint64_t key = 0;
+    if (!cacheDirectory.empty()) {
+        key = details::cacheKey(face_->hash(), letterSize_, distanceField_);
+        cachePath = details::cachePath(cacheDirectory, filePath_, letterSize_, distanceField_);
+
+        // a cached atlas is uploaded right from the mapped file, FreeType parses
+        // the face later if a glyph out of the alphabet is needed
+        MappedFile cache;
+        Image::Bytes pixels(nullptr, 0);
+        if (cache.open(cachePath) && details::readAtlas(cache, key, letters_, metrics, pixels))
+            return addAtlas(metrics, pixels);
+    }
+
+    std::vector<uint8_t> pixels;
+    if (!details::generateAtlas(*face_, letterSize_, distanceField_, letters_, metrics, pixels))
+        return false;
+    Image::Bytes bytes(pixels.data(), (uint32_t)pixels.size());
+    if (!cachePath.empty())
+        details::writeAtlas(cachePath, key, letters_, metrics, bytes);
+    return addAtlas(metrics, bytes);
+}
+
+bool FontImpl::addAtlas(const AtlasMetrics& metrics, Image::Bytes pixels) {
+
+    auto atlas = renderer_.makeImage(metrics.size, Image::Format::A, true);
+    if (!atlas)
+        return false;
+    atlas->upload(pixels);
+    pages_.push_back(atlas);
+    metrics_ = metrics;
+
+    // pages of glyphs rasterized on demand are grids of square slots, wide glyphs
+    // take several slots of a row
+    auto slotSize = metrics_.lineHeight;
+    pageSize_ = std::min((uint32_t)Image::kMaxSize,
+        details::nextPowerOfTwo(slotSize * kPageColumns));
+    pageSlots_ = (pageSize_ / slotSize) * (pageSize_ / slotSize);
+    return true;
+}
+
+const Letter* FontImpl::acquire(wchar_t c) {
+
+    auto* letter = letters_.find(c);
+    if (!letter)
+        return addLetter(c);
+
+    if (letter->page != 0 && letter->refs++ == 0)
+        unused_.erase(letter->unused);
+    return letter;
+}
+
+void FontImpl::release(wchar_t c) {
+
+    auto* letter = letters_.find(c);
+    if (letter && letter->page != 0 && --letter->refs == 0)
+        letter->unused = unused_.insert(unused_.end(), c);
+}
+
+const Letter* FontImpl::addLetter(wchar_t c) {
+
+    if (missing_.count(c) != 0)
+        return nullptr;
+    auto* context = face_->context(letterSize_);
+    auto* glyph = context ? context->getGlyph(c) : nullptr;
+    if (!glyph) {
+        missing_.insert(c);
+        return nullptr;
+    }
+
+    TraceScope trace("Font::addLetter");
+    // glyphs wider than the line height take a run of slots in a row
+    auto slotSize = metrics_.lineHeight;
+    auto columns = pageSize_ / slotSize;
+    auto glyphWidth = details::letterWidth(c, glyph);
+    auto span = std::min(columns,
+        (uint32_t)std::ceil((glyphWidth + metrics_.border * 2) / slotSize));
+    span = std::max(span, 1u);
+    uint32_t slot = 0;
+    while (!findSlots(span, slot)) {
+        if (!unused_.empty()) {
+            // the least recently used glyphs give their slots away
+            auto evicted = unused_.front();
+            unused_.pop_front();
+            auto* letter = letters_.find(evicted);
+            std::fill_n(slots_.begin() + letter->slot, letter->span, false);
+            letters_.erase(evicted);
+        }
+        else if (!addPage()) {
+            return nullptr;
+        }
+    }
+    std::fill_n(slots_.begin() + slot, span, true);
+
+    auto index = slot % pageSlots_;
+    auto x = (int32_t)((index % columns) * slotSize);
+    auto y = (int32_t)((index / columns) * slotSize);
+
+    // the glyph is rendered into its slots only, so it never spills into others
+    auto page = 1 + slot / pageSlots_;
+    auto cellWidth = span * slotSize;
+    Rect region(x, y, x + (int32_t)cellWidth, y + (int32_t)slotSize);
+    auto width = std::min(glyphWidth, (double)(cellWidth - metrics_.border * 2));
+    if (distanceField_) {
+        std::vector<uint8_t> cell((size_t)cellWidth * slotSize, 0);
+        context = face_->context(letterSize_ * details::kDistanceScale);
+        auto* largeGlyph = context ? context->getGlyph(c) : nullptr;
+        if (largeGlyph) {
+            details::DistanceField field;
+            details::renderDistance(*context, largeGlyph, cellWidth, slotSize,
+                (int32_t)metrics_.border, metrics_.baseline, metrics_.border, field,
+                cell.data(), cellWidth);
+        }
+        pages_[page]->upload(region, Image::Bytes(cell.data(), (uint32_t)cell.size()), 0);
+    }
+    else {
+        details::Renderer renderer(cellWidth, slotSize);
+        context->renderGlyph(renderer, glyph, metrics_.border, metrics_.baseline);
+        pages_[page]->upload(region, Image::Bytes(renderer.data(), (uint32_t)renderer.size()), 0);
+    }
+
+    auto& letter = letters_.add(c);
+    letter.rect = details::letterRect(x, y, width, metrics_);
+    letter.page = page;
+    letter.slot = slot;
+    letter.span = span;
+    letter.refs = 1;
+    return &letter;
+}
+
+bool FontImpl::addPage() {
+
+    auto page = renderer_.makeImage({pageSize_, pageSize_}, Image::Format::A, true);
+    if (!page)
+        return false;
+    std::vector<uint8_t> clear((size_t)pageSize_ * pageSize_, 0);
+    page->upload(Image::Bytes(clear.data(), (uint32_t)clear.size()));
+    pages_.push_back(page);
+    slots_.resize(slots_.size() + pageSlots_, false);
+    return true;
+}
+
+bool FontImpl::findSlots(uint32_t span, uint32_t& slot) const {
+
+    // page rows are rows of the slot grid, so a run never crosses pages
+    auto columns = pageSize_ / metrics_.lineHeight;
+    for (size_t row = 0; row < slots_.size(); row += columns) {
+        uint32_t run = 0;
+        for (uint32_t column = 0; column < columns; ++column) {
+            run = slots_[row + column] ? 0 : run + 1;
+            if (run == span) {
+                slot = (uint32_t)row + column + 1 - span;
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
 } //namespace draw
@@ -1,40 +1,182 @@
 #pragma once
 #include <draw.h>
+#include <file.h>
+#include <array>
 #include <string>
+#include <list>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace draw {
 
 static const wchar_t kSpaceSymbol = L' ';
 
-using Letters = std::unordered_map<wchar_t, Rect>;
+struct Letter {
+
+    Rect rect; // texels of its page
+    uint32_t page {0};
+    // glyphs rasterized on demand only (page > 0), the first of span slots in a row
+    uint32_t slot {0};
+    uint32_t span {0};
+    uint32_t refs {0};
+    std::list<wchar_t>::iterator unused; // position in the eviction order when refs is 0
+    bool added {false}; // entries of Letters without a letter are not added
+};
+
+// letters of the BMP in direct-indexed blocks of 256 characters, so layout finds
+// a letter with two loads and no hashing, the Latin-1 block always exists and
+// others are allocated with their first letters, rarer characters are hashed
+class Letters final {
+
+public:
+    Letters();
+
+    Letters(const Letters&) = delete;
+    Letters& operator = (const Letters&) = delete;
+
+    Letter* find(wchar_t c) {
+
+        auto code = (uint32_t)c;
+        if (code >= kBlockCount * kBlockSize)
+            return findOther(c);
+        const auto& block = blocks_[code / kBlockSize];
+        if (!block)
+            return nullptr;
+        auto& letter = (*block)[code % kBlockSize];
+        return letter.added ? &letter : nullptr;
+    }
+
+    // returns the letter of the character, a new one is added if there is none
+    Letter& add(wchar_t c);
+    void erase(wchar_t c);
+    void clear();
+    size_t size() const { return size_; }
+
+    template <typename Function>
+    void forEach(Function&& function) const {
+
+        for (size_t i = 0; i < blocks_.size(); ++i) {
+            for (size_t j = 0; blocks_[i] && j < kBlockSize; ++j) {
+                const auto& letter = (*blocks_[i])[j];
+                if (letter.added)
+                    function((wchar_t)(i * kBlockSize + j), letter);
+            }
+        }
+        for (const auto& letter : others_)
+            function(letter.first, letter.second);
+    }
+
+private:
+    static const uint32_t kBlockSize = 256;
+    static const uint32_t kBlockCount = 256;
+
+    using Block = std::array<Letter, kBlockSize>;
+
+    Letter* findOther(wchar_t c);
+
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::unordered_map<wchar_t, Letter> others_;
+    size_t size_ {0};
+};
+
+// layout of glyph cells, which span the whole line height
+struct AtlasMetrics {
+
+    Size size {0, 0};
+    uint32_t lineHeight {0}; // cell height with borders
+    int32_t baseline {0}; // from the bottom of a cell
+    uint32_t border {0}; // empty texels around glyphs
+};
+
+namespace details {
+class Context;
+}
 
 class RendererImpl;
+class WorkerPool;
+
+// font file mapped once and shared by fonts of all letter sizes made from it
+class FontFace final {
+
+public:
+    FontFace(RendererImpl& renderer, const std::string& filePath);
+    ~FontFace();
+
+    FontFace(const FontFace&) = delete;
+    FontFace& operator = (const FontFace&) = delete;
+
+    bool init();
+    const std::string& filePath() const { return filePath_; }
+    const MappedFile& file() const { return file_; }
+    // hash of the file content computed on the first call
+    uint64_t hash();
+    // FreeType face parsed on the first call, glyphs rasterized next get the letter size,
+    // FreeType faces are not thread safe, so every worker thread gets its own context
+    details::Context* context(uint32_t letterSize, uint32_t thread = 0);
+    WorkerPool& workers();
+
+private:
+    RendererImpl& renderer_;
+    std::string filePath_;
+    MappedFile file_;
+    uint64_t hash_ {0};
+    bool hashed_ {false};
+    std::vector<std::unique_ptr<details::Context>> contexts_;
+    std::vector<uint8_t> invalidContexts_;
+};
+
+using FontFacePtr = std::shared_ptr<FontFace>;
 
 class FontImpl final : public Font {
 
 public:
-    FontImpl(RendererImpl& renderer, const char* filePath, uint32_t letterSize);
-    virtual ~FontImpl() = default;
+    FontImpl(RendererImpl& renderer, const char* filePath, uint32_t letterSize,
+        bool distanceField);
+    virtual ~FontImpl();
 
     FontImpl(const FontImpl&) = delete;
     FontImpl& operator = (const FontImpl&) = delete;
 
     bool init();
-    ImagePtr atlas() const { return atlas_; }
-    const Letters& letters() const { return letters_; }
+    // page 0 is the alphabet atlas, others hold glyphs rasterized on demand
+    const ImagePtr& page(uint32_t index) const { return pages_[index]; }
+    // returns nullptr if the font has no glyph of the character, acquired
+    // glyphs are never evicted until they are released
+    const Letter* acquire(wchar_t c);
+    void release(wchar_t c);
 
     // Font
 
     virtual const char* filePath() const final { return filePath_.c_str(); }
     virtual uint32_t letterSize() const final { return letterSize_; }
+    virtual bool distanceField() const final { return distanceField_; }
 
 private:
+    static const uint32_t kPageColumns = 8;
+
+    bool addAtlas(const AtlasMetrics& metrics, Image::Bytes pixels);
+    const Letter* addLetter(wchar_t c);
+    bool addPage();
+    // finds span free slots in a row of a page
+    bool findSlots(uint32_t span, uint32_t& slot) const;
+
     RendererImpl& renderer_;
 	std::string filePath_;
 	uint32_t letterSize_ {0};
+    bool distanceField_ {false};
 	Letters letters_;
-	ImagePtr atlas_;
+    std::vector<ImagePtr> pages_;
+
+    FontFacePtr face_;
+    AtlasMetrics metrics_;
+    uint32_t pageSize_ {0};
+    uint32_t pageSlots_ {0};
+    std::vector<bool> slots_; // used slots of all pages
+    // released glyphs from the least recently used one
+    std::list<wchar_t> unused_;
+    std::unordered_set<wchar_t> missing_;
 };
 
 } // namespace draw
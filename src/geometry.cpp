@@ -1,43 +1,78 @@
 #include "geometry.h"
 #include <renderer.h>
 #include <error.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 
 namespace draw {
 
+// the software backend reads vertices of shared arena pages by index, so indices
+// must stay within the vertices allocated for the geometry
+inline bool indicesInRange(Geometry::Indices indices, uint32_t vertexCapacity) {
+
+    return std::all_of(indices.ptr, indices.ptr + indices.count,
+        [vertexCapacity](Geometry::Index index) { return index < vertexCapacity; });
+}
+
 GeometryImpl::GeometryImpl(RendererImpl& renderer, Geometry::Vertices vertices,
     Geometry::Indices indices, Geometry::Primitive primitive) :
     renderer_(renderer),
     vertices_(vertices),
     indices_(indices),
-    primitive_(primitive) {
+    primitive_(primitive),
+    usage_(Usage::Static),
+    vertexCount_(vertices.count),
+    indexCount_(indices.count),
+    vertexCapacity_(vertices.count),
+    indexCapacity_(indices.count),
+    bounds_(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX) {
 }
 
-GeometryImpl::~GeometryImpl() {
+GeometryImpl::GeometryImpl(RendererImpl& renderer, Geometry::Vertices vertices,
+    Geometry::Indices indices, Geometry::Primitive primitive,
+    uint32_t vertexCapacity, uint32_t indexCapacity) :
+    renderer_(renderer),
+    vertices_(vertices),
+    indices_(indices),
+    primitive_(primitive),
+    usage_(Usage::Dynamic),
+    vertexCount_(vertices.count),
+    indexCount_(indices.count),
+    vertexCapacity_(vertexCapacity),
+    indexCapacity_(indexCapacity),
+    bounds_(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX) {
+}
 
-    renderer_.setContext();
+GeometryImpl::~GeometryImpl() {
 
-    glDeleteBuffers(1, &vb_);
-    glDeleteBuffers(1, &ib_);
+    if (shared_)
+        renderer_.releaseSharedGeometry(hash_, this);
+    renderer_.arena(usage_).free(allocation_);
 }
 
 bool GeometryImpl::init() {
 
-    if (!vertices_.ptr || vertices_.count <= 0 || vertices_.count > kMaxVertexCount ||
-        !indices_.ptr || indices_.count <= 0) {
+    auto dynamic = (usage_ == Usage::Dynamic);
+    if ((!vertices_.ptr && (!dynamic || vertices_.count > 0)) ||
+        (!indices_.ptr && (!dynamic || indices_.count > 0)) ||
+        (!dynamic && (vertices_.count <= 0 || indices_.count <= 0)) ||
+        vertexCapacity_ <= 0 || vertexCapacity_ > kMaxVertexCount ||
+        vertexCapacity_ < vertices_.count ||
+        indexCapacity_ <= 0 || indexCapacity_ < indices_.count ||
+        !indicesInRange(indices_, vertexCapacity_)) {
         setError(InvalidArgument);
         return false;
     }
-    renderer_.setContext();
-
-    glGenBuffers(1, &vb_);
-    glBindBuffer(GL_ARRAY_BUFFER, vb_);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices_.count,
-        vertices_.ptr, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &ib_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ib_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index) * indices_.count,
-        indices_.ptr, GL_STATIC_DRAW);
+    auto& arena = renderer_.arena(usage_);
+    if (!arena.allocate(vertexCapacity_, indexCapacity_, allocation_)) {
+        setError(OpenGLOutOfMemory);
+        return false;
+    }
+    arena.upload(allocation_, 0, vertices_, 0, indices_);
+    extend(vertices_);
+    vertices_ = Vertices(nullptr, 0);
+    indices_ = Indices(nullptr, 0);
 
     if (glGetError() == GL_OUT_OF_MEMORY) {
         setError(OpenGLOutOfMemory);
@@ -47,4 +82,67 @@ bool GeometryImpl::init() {
     return true;
 }
 
+void GeometryImpl::share(uint64_t hash, Vertices vertices, Indices indices) {
+
+    shared_ = true;
+    hash_ = hash;
+    sharedVertices_.assign(vertices.ptr, vertices.ptr + vertices.count);
+    sharedIndices_.assign(indices.ptr, indices.ptr + indices.count);
+}
+
+bool GeometryImpl::equals(Vertices vertices, Indices indices, Primitive primitive) const {
+
+    return shared_ && primitive_ == primitive &&
+        sharedVertices_.size() == vertices.count && sharedIndices_.size() == indices.count &&
+        memcmp(sharedVertices_.data(), vertices.ptr, sizeof(Vertex) * vertices.count) == 0 &&
+        memcmp(sharedIndices_.data(), indices.ptr, sizeof(Index) * indices.count) == 0;
+}
+
+void GeometryImpl::update(uint32_t vertexOffset, Vertices vertices,
+    uint32_t indexOffset, Indices indices) {
+
+    if (usage_ != Usage::Dynamic ||
+        (!vertices.ptr && vertices.count > 0) ||
+        (!indices.ptr && indices.count > 0) ||
+        // ranges are checked without sums, so large offsets don't wrap around
+        vertexOffset > vertexCapacity_ || vertices.count > vertexCapacity_ - vertexOffset ||
+        indexOffset > indexCapacity_ || indices.count > indexCapacity_ - indexOffset ||
+        !indicesInRange(indices, vertexCapacity_)) {
+        setError(InvalidArgument);
+        return;
+    }
+    renderer_.arena(usage_).upload(allocation_, vertexOffset, vertices, indexOffset, indices);
+    extend(vertices);
+
+    if (vertices.count > 0)
+        vertexCount_ = std::max(vertexCount_, vertexOffset + vertices.count);
+    if (indices.count > 0)
+        indexCount_ = std::max(indexCount_, indexOffset + indices.count);
+
+    ASSERT(glGetError() == GL_NO_ERROR);
+}
+
+void GeometryImpl::extend(Vertices vertices) {
+
+    // overwritten vertices are not excluded, so the bounds stay conservative
+    for (uint32_t i = 0; i < vertices.count; ++i) {
+        const auto& position = vertices.ptr[i].position;
+        bounds_.x = std::min(bounds_.x, position.x);
+        bounds_.y = std::min(bounds_.y, position.y);
+        bounds_.z = std::max(bounds_.z, position.x);
+        bounds_.w = std::max(bounds_.w, position.y);
+    }
+}
+
+void GeometryImpl::resize(uint32_t vertexCount, uint32_t indexCount) {
+
+    if (usage_ != Usage::Dynamic ||
+        vertexCount > vertexCapacity_ || indexCount > indexCapacity_) {
+        setError(InvalidArgument);
+        return;
+    }
+    vertexCount_ = vertexCount;
+    indexCount_ = indexCount;
+}
+
 } // namespace draw
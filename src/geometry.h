@@ -1,6 +1,8 @@
 #pragma once
 #include <draw.h>
-#include <GL/glew.h>
+#include <arena.h>
+#include <common.h>
+#include <vector>
 
 namespace draw {
 
@@ -11,28 +13,55 @@ class GeometryImpl final : public Geometry {
 public:
     GeometryImpl(RendererImpl& renderer, Geometry::Vertices vertices,
         Geometry::Indices indices, Geometry::Primitive primitive);
+    GeometryImpl(RendererImpl& renderer, Geometry::Vertices vertices,
+        Geometry::Indices indices, Geometry::Primitive primitive,
+        uint32_t vertexCapacity, uint32_t indexCapacity);
     virtual ~GeometryImpl();
 
     GeometryImpl(const GeometryImpl&) = delete;
     GeometryImpl& operator = (const GeometryImpl&) = delete;
 
     bool init();
-    GLuint vb() { return vb_; }
-    GLuint ib() { return ib_; }
+    const GeometryArena::Page* page() const { return allocation_.page; }
+    uint32_t baseVertex() const { return allocation_.baseVertex; }
+    uint32_t firstIndex() const { return allocation_.firstIndex; }
+    // bounds of all vertices ever uploaded: minimum in x, y and maximum in z, w
+    const Vector4& bounds() const { return bounds_; }
+
+    void share(uint64_t hash, Vertices vertices, Indices indices);
+    bool equals(Vertices vertices, Indices indices, Primitive primitive) const;
 
     // Geometry
 
-    virtual uint32_t vertexCount() const final { return vertices_.count; }
-    virtual uint32_t indexCount() const final { return indices_.count; }
+    virtual uint32_t vertexCount() const final { return vertexCount_; }
+    virtual uint32_t indexCount() const final { return indexCount_; }
     virtual Primitive primitive() const final { return primitive_; }
+    virtual Usage usage() const final { return usage_; }
+    virtual uint32_t vertexCapacity() const final { return vertexCapacity_; }
+    virtual uint32_t indexCapacity() const final { return indexCapacity_; }
+
+    virtual void update(uint32_t vertexOffset, Vertices vertices,
+        uint32_t indexOffset, Indices indices) final;
+    virtual void resize(uint32_t vertexCount, uint32_t indexCount) final;
 
 private:
+    void extend(Vertices vertices);
+
     RendererImpl& renderer_;
     Vertices vertices_;
     Indices indices_;
     Primitive primitive_ {Primitive::Triangle};
-    GLuint vb_ {0};
-    GLuint ib_ {0};
+    Usage usage_ {Usage::Static};
+    uint32_t vertexCount_ {0};
+    uint32_t indexCount_ {0};
+    uint32_t vertexCapacity_ {0};
+    uint32_t indexCapacity_ {0};
+    GeometryArena::Allocation allocation_;
+    Vector4 bounds_;
+    bool shared_ {false};
+    uint64_t hash_ {0};
+    std::vector<Vertex> sharedVertices_;
+    std::vector<Index> sharedIndices_;
 };
 
 } // namespace draw
@@ -1,17 +1,27 @@
 #include "image.h"
 #include <renderer.h>
 #include <error.h>
+#include <trace.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DRAW_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace draw {
 
-inline GLenum glFormat(Image::Format format) {
+inline bool compressed(Image::Format format) {
 
     switch (format) {
-    case Image::Format::A: return GL_ALPHA;
-    case Image::Format::RGB: return GL_RGB;
-    case Image::Format::RGBA: return GL_RGBA;
+    case Image::Format::ETC2:
+    case Image::Format::ETC2A:
+    case Image::Format::BC1:
+    case Image::Format::BC3:
+    case Image::Format::BC7: return true;
+    default: return false;
     }
-    return 0;
 }
 
 inline GLenum glInternalFormat(Image::Format format) {
@@ -20,57 +30,556 @@ inline GLenum glInternalFormat(Image::Format format) {
     case Image::Format::A: return GL_ALPHA8;
     case Image::Format::RGB: return GL_RGB8;
     case Image::Format::RGBA: return GL_RGBA8;
+    case Image::Format::BGRA: return GL_RGBA8;
+    case Image::Format::RGB565: return GL_RGB5;
+    case Image::Format::RGBA4444: return GL_RGBA4;
+    case Image::Format::ETC2: return GL_COMPRESSED_RGB8_ETC2;
+    case Image::Format::ETC2A: return GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case Image::Format::BC1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case Image::Format::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case Image::Format::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
     }
     return 0;
 }
 
+inline GLenum glFormat(Image::Format format) {
+
+    switch (format) {
+    case Image::Format::A: return GL_ALPHA;
+    case Image::Format::RGB: return GL_RGB;
+    case Image::Format::RGBA: return GL_RGBA;
+    case Image::Format::BGRA: return GL_BGRA;
+    case Image::Format::RGB565: return GL_RGB;
+    case Image::Format::RGBA4444: return GL_RGBA;
+    default: return glInternalFormat(format);
+    }
+}
+
+inline GLenum glType(Image::Format format) {
+
+    switch (format) {
+    case Image::Format::RGB565: return GL_UNSIGNED_SHORT_5_6_5;
+    case Image::Format::RGBA4444: return GL_UNSIGNED_SHORT_4_4_4_4;
+    default: return GL_UNSIGNED_BYTE;
+    }
+}
+
+// bytes per pixel, or bytes per block for compressed formats
 inline uint32_t bpp(Image::Format format) {
 
     switch (format) {
     case Image::Format::A: return 1;
     case Image::Format::RGB: return 3;
     case Image::Format::RGBA: return 4;
+    case Image::Format::BGRA: return 4;
+    case Image::Format::RGB565: return 2;
+    case Image::Format::RGBA4444: return 2;
+    case Image::Format::ETC2: return 8;
+    case Image::Format::ETC2A: return 16;
+    case Image::Format::BC1: return 8;
+    case Image::Format::BC3: return 16;
+    case Image::Format::BC7: return 16;
     }
     return 0;
 }
 
-ImageImpl::ImageImpl(RendererImpl& renderer, const Size& size,
-    Image::Format format, bool filter) :
+inline GLint mipLevels(const Size& size) {
+
+    GLint levels = 1;
+    for (auto side = std::max(size.width, size.height); side > 1; side /= 2)
+        ++levels;
+    return levels;
+}
+
+inline uint32_t byteSize(Image::Format format, uint32_t width, uint32_t height) {
+
+    if (compressed(format)) {
+        const auto block = Image::kBlockSize;
+        return ((width + block - 1) / block) * ((height + block - 1) / block) * bpp(format);
+    }
+    return width * height * bpp(format);
+}
+
+#ifdef DRAW_SSE2
+// filters 16 bytes of both rows at once into 8 alpha or 2 RGBA pixels of the next level
+inline void boxFilter16(const uint8_t* row0, const uint8_t* row1, uint32_t channels,
+    uint8_t* dst) {
+
+    auto zero = _mm_setzero_si128();
+    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+    __m128i sum;
+    if (channels == 1) {
+        auto mask = _mm_set1_epi16(0xFF);
+        sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)),
+            _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
+    }
+    else {
+        // column sums of pixels 0, 1 and 2, 3 are added to their neighbours
+        auto low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        auto high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        sum = _mm_unpacklo_epi64(_mm_add_epi16(low, _mm_srli_si128(low, 8)),
+            _mm_add_epi16(high, _mm_srli_si128(high, 8)));
+    }
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(sum, zero));
+}
+#endif
+
+// averages 2x2 pixels of 8-bit channels into a region of the next level,
+// the last row/column is repeated for odd sizes
+inline void boxFilter(const uint8_t* src, uint32_t width, uint32_t height,
+    uint32_t channels, const Rect& region, uint8_t* dst) {
+
+    auto dstWidth = std::max(width / 2, 1u);
+    for (uint32_t y = region.bottom; y < (uint32_t)region.top; ++y) {
+        auto row0 = src + std::min(y * 2, height - 1) * width * channels;
+        auto row1 = src + std::min(y * 2 + 1, height - 1) * width * channels;
+        auto out = dst + (y * dstWidth + region.left) * channels;
+        uint32_t x = region.left;
+#ifdef DRAW_SSE2
+        if (channels == 1 || channels == 4) {
+            auto step = 8 / channels;
+            for (; x + step <= (uint32_t)region.right && (x + step) * 2 <= width;
+                x += step, out += 8) {
+                boxFilter16(row0 + x * 2 * channels, row1 + x * 2 * channels, channels, out);
+            }
+        }
+#endif
+        for (; x < (uint32_t)region.right; ++x) {
+            auto x0 = std::min(x * 2, width - 1) * channels;
+            auto x1 = std::min(x * 2 + 1, width - 1) * channels;
+            for (uint32_t c = 0; c < channels; ++c) {
+                *out++ = uint8_t((row0[x0 + c] + row0[x1 + c] +
+                    row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+}
+
+// averages 2x2 pixels of 16-bit packed formats into a region of the next level,
+// fields go from the highest bits
+template <uint32_t N>
+inline void boxFilter(const uint16_t* src, uint32_t width, uint32_t height,
+    const uint32_t (&fields)[N], const Rect& region, uint16_t* dst) {
+
+    auto dstWidth = std::max(width / 2, 1u);
+    for (uint32_t y = region.bottom; y < (uint32_t)region.top; ++y) {
+        auto row0 = src + std::min(y * 2, height - 1) * width;
+        auto row1 = src + std::min(y * 2 + 1, height - 1) * width;
+        auto out = dst + y * dstWidth + region.left;
+        for (uint32_t x = region.left; x < (uint32_t)region.right; ++x) {
+            auto x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            uint32_t shift = 16, pixel = 0;
+            for (auto bits : fields) {
+                shift -= bits;
+                auto mask = (1u << bits) - 1;
+                auto sum = ((row0[x0] >> shift) & mask) + ((row0[x1] >> shift) & mask) +
+                    ((row1[x0] >> shift) & mask) + ((row1[x1] >> shift) & mask);
+                pixel |= ((sum + 2) / 4) << shift;
+            }
+            *out++ = uint16_t(pixel);
+        }
+    }
+}
+
+// filters a region of the next level, dst points to the whole level
+inline void downsample(Image::Format format, const uint8_t* src, uint32_t width,
+    uint32_t height, const Rect& region, uint8_t* dst) {
+
+    static const uint32_t kRGB565[] = {5, 6, 5};
+    static const uint32_t kRGBA4444[] = {4, 4, 4, 4};
+
+    switch (format) {
+    case Image::Format::RGB565:
+        boxFilter(reinterpret_cast<const uint16_t*>(src), width, height, kRGB565, region,
+            reinterpret_cast<uint16_t*>(dst));
+        break;
+    case Image::Format::RGBA4444:
+        boxFilter(reinterpret_cast<const uint16_t*>(src), width, height, kRGBA4444, region,
+            reinterpret_cast<uint16_t*>(dst));
+        break;
+    default:
+        boxFilter(src, width, height, bpp(format), region, dst);
+        break;
+    }
+}
+
+// copies a region into rows of an image of the given width, compressed formats by blocks
+inline void copyRegion(Image::Format format, const Rect& region, const uint8_t* src,
+    uint32_t rowLength, uint32_t width, uint8_t* dst) {
+
+    auto left = region.left, bottom = region.bottom, right = region.right, top = region.top;
+    if (compressed(format)) {
+        const auto block = (int32_t)Image::kBlockSize;
+        left /= block;
+        bottom /= block;
+        right = (right + block - 1) / block;
+        top = (top + block - 1) / block;
+        width = (width + block - 1) / block;
+    }
+    auto pixelSize = bpp(format);
+    auto rowSize = (right - left) * pixelSize;
+    auto srcStride = rowLength > 0 ? rowLength * pixelSize : rowSize;
+    for (auto y = bottom; y < top; ++y)
+        memcpy(dst + (y * width + left) * pixelSize, src + (y - bottom) * srcStride, rowSize);
+}
+
+inline uint64_t hashImage(const Size& size, Image::Format format, bool filter,
+    bool mipmaps, Image::Bytes bytes) {
+
+    uint32_t params[] = {size.width, size.height, (uint32_t)format, filter ? 1u : 0u,
+        mipmaps ? 1u : 0u};
+    return hash(bytes.ptr, bytes.count, hash(params, sizeof(params)));
+}
+
+Texture::Texture(RendererImpl& renderer, const Size& size,
+    Image::Format format, bool filter, bool mipmaps) :
     renderer_(renderer),
     size_(size),
     format_(format),
-    filter_(filter) {
+    filter_(filter),
+    mipmaps_(mipmaps) {
 }
 
-ImageImpl::~ImageImpl() {
+Texture::~Texture() {
+
+    unshare();
+    renderer_.unregisterTexture(this);
 
     renderer_.setContext();
 
     glDeleteTextures(1, &handle_);
 }
 
-bool ImageImpl::init() {
+bool Texture::init() {
 
-    if (size_.width <= 0 || size_.width > Image::kMaxSize ||
-        size_.height <= 0 || size_.height > Image::kMaxSize) {
-        setError(InvalidArgument);
+    if (!allocate())
         return false;
-    }
+    if (mipmaps_ && !renderer_.generateMipmap())
+        levels_.resize(memory());
+    if (renderer_.software())
+        texels_.resize(size_.width * size_.height * 4);
+
+    lastUse_ = renderer_.frame();
+    renderer_.registerTexture(this);
+    return true;
+}
+
+bool Texture::create() {
+
     renderer_.setContext();
 
     glGenTextures(1, &handle_);
     glBindTexture(GL_TEXTURE_2D, handle_);
 
     auto glFilter = filter_ ? GL_LINEAR : GL_NEAREST;
+    auto glMinFilter = !mipmaps_ ? glFilter :
+        filter_ ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_NEAREST;
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, glFilter);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, glFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, glMinFilter);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, glInternalFormat(format_), size_.width,
-        size_.height, 0, glFormat(format_), GL_UNSIGNED_BYTE, nullptr);
+    if (compressed(format_)) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, glInternalFormat(format_), size_.width,
+            size_.height, 0, byteSize(format_, size_.width, size_.height), nullptr);
+    }
+    else {
+        GLint level = 0;
+        auto width = size_.width, height = size_.height;
+        do {
+            glTexImage2D(GL_TEXTURE_2D, level++, glInternalFormat(format_), width,
+                height, 0, glFormat(format_), glType(format_), nullptr);
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        } while (mipmaps_ && level < mipLevels(size_));
+    }
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        glDeleteTextures(1, &handle_);
+        handle_ = 0;
+        return false;
+    }
+    ASSERT(glGetError() == GL_NO_ERROR);
+    resident_ = true;
+    return true;
+}
+
+bool Texture::allocate() {
+
+    // make room by evicting the least recently drawn textures and try again
+    if (!create() && (!renderer_.evictTextures(memory()) || !create())) {
+        setError(OpenGLOutOfMemory);
+        return false;
+    }
+    return true;
+}
+
+bool Texture::restore(bool keepContent) {
+
+    if (!allocate())
+        return false;
+    renderer_.restoreTexture(this);
+    // the shared bytes, the CPU mip levels or the backing copy
+    auto& content = shared_ ? bytes_ : !levels_.empty() ? levels_ : backing_;
+    if (keepContent && !content.empty()) {
+        upload(Rect(0, 0, size_.width, size_.height),
+            Image::Bytes(content.data(), (uint32_t)content.size()), 0);
+    }
+    return true;
+}
+
+bool Texture::evict() {
+
+    // the software rasterizer reads the texels, so there is nothing to free
+    if (pinned_ || !resident_ || renderer_.software())
+        return false;
+
+    // the content is kept on CPU since upload, so nothing is read back
+    renderer_.setContext();
+    glDeleteTextures(1, &handle_);
+    handle_ = 0;
+    resident_ = false;
+    return true;
+}
+
+bool Texture::backing() const {
+
+    // CPU mipmapped levels are a copy already, pinned and software textures stay resident
+    return !pinned_ && !shared_ && levels_.empty() && !renderer_.software();
+}
+
+GLuint Texture::use(uint64_t frame) {
+
+    lastUse_ = frame;
+    if (!resident_)
+        restore(true);
+    return handle_;
+}
+
+uint64_t Texture::memory() const {
+
+    if (!mipmaps_)
+        return byteSize(format_, size_.width, size_.height);
+
+    uint64_t bytes = 0;
+    auto width = size_.width, height = size_.height;
+    for (GLint i = 0; i < mipLevels(size_); ++i) {
+        bytes += byteSize(format_, width, height);
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return bytes;
+}
+
+void Texture::upload(const Rect& region, Image::Bytes bytes, uint32_t rowLength) {
+
+    // an evicted texture is restored, its content is not needed if it is overwritten
+    if (!resident_ && !restore(region != Rect(0, 0, size_.width, size_.height)))
+        return;
+
+    renderer_.setContext();
+
+    glBindTexture(GL_TEXTURE_2D, handle_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (rowLength > 0)
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+
+    auto width = region.right - region.left, height = region.top - region.bottom;
+    if (compressed(format_)) {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, region.left, region.bottom, width, height,
+            glFormat(format_), byteSize(format_, width, height), bytes.ptr);
+    }
+    else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, region.left, region.bottom, width, height,
+            glFormat(format_), glType(format_), bytes.ptr);
+    }
+
+    if (rowLength > 0)
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    if (backing() && bytes.ptr && bytes.ptr != backing_.data()) {
+        backing_.resize(byteSize(format_, size_.width, size_.height));
+        copyRegion(format_, region, bytes.ptr, rowLength, size_.width, backing_.data());
+    }
+    if (mipmaps_)
+        updateMipmaps(region, bytes, rowLength);
+    if (!texels_.empty() && bytes.ptr)
+        updateTexels(region, bytes, rowLength);
+
+    ASSERT(glGetError() == GL_NO_ERROR);
+}
+
+void Texture::updateTexels(const Rect& region, Image::Bytes bytes, uint32_t rowLength) {
+
+    // converted the way OpenGL expands formats to RGBA, alpha only ones are black
+    auto pixelSize = bpp(format_);
+    auto width = region.right - region.left;
+    auto srcStride = (rowLength > 0 ? rowLength : width) * pixelSize;
+    for (auto y = region.bottom; y < region.top; ++y) {
+        auto* src = bytes.ptr + (y - region.bottom) * srcStride;
+        auto* dst = &texels_[(y * size_.width + region.left) * 4];
+        for (auto x = 0; x < width; ++x, src += pixelSize, dst += 4) {
+            uint16_t packed = 0;
+            switch (format_) {
+            case Image::Format::A:
+                dst[0] = dst[1] = dst[2] = 0;
+                dst[3] = src[0];
+                break;
+            case Image::Format::RGB:
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                dst[3] = 0xFF;
+                break;
+            case Image::Format::RGBA:
+                memcpy(dst, src, 4);
+                break;
+            case Image::Format::BGRA:
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = src[3];
+                break;
+            case Image::Format::RGB565:
+                memcpy(&packed, src, sizeof(packed));
+                dst[0] = uint8_t((packed >> 11 & 0x1F) * 255 / 31);
+                dst[1] = uint8_t((packed >> 5 & 0x3F) * 255 / 63);
+                dst[2] = uint8_t((packed & 0x1F) * 255 / 31);
+                dst[3] = 0xFF;
+                break;
+            case Image::Format::RGBA4444:
+                memcpy(&packed, src, sizeof(packed));
+                dst[0] = uint8_t((packed >> 12 & 0xF) * 17);
+                dst[1] = uint8_t((packed >> 8 & 0xF) * 17);
+                dst[2] = uint8_t((packed >> 4 & 0xF) * 17);
+                dst[3] = uint8_t((packed & 0xF) * 17);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+void Texture::updateMipmaps(const Rect& region, Image::Bytes bytes, uint32_t rowLength) {
+
+    if (renderer_.generateMipmap()) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        return;
+    }
+    // without glGenerateMipmap all levels are kept on CPU, only the footprint of the
+    // region is filtered and uploaded in each level, a restore uploads the kept levels
+    auto restore = bytes.ptr == levels_.data();
+    auto pixelSize = bpp(format_);
+    if (!restore && bytes.ptr)
+        copyRegion(format_, region, bytes.ptr, rowLength, size_.width, levels_.data());
+    auto level = levels_.data();
+    auto width = size_.width, height = size_.height;
+    auto dirty = region;
+    for (GLint i = 1; i < mipLevels(size_); ++i) {
+        auto next = level + byteSize(format_, width, height);
+        auto nextWidth = std::max(width / 2, 1u), nextHeight = std::max(height / 2, 1u);
+        if (restore) {
+            dirty = Rect(0, 0, nextWidth, nextHeight);
+        }
+        else {
+            dirty = Rect(dirty.left / 2, dirty.bottom / 2,
+                std::min((dirty.right + 1) / 2, (int32_t)nextWidth),
+                std::min((dirty.top + 1) / 2, (int32_t)nextHeight));
+            // the last column or row of odd sizes is not filtered into the next level
+            if (dirty.left >= dirty.right || dirty.bottom >= dirty.top)
+                break;
+            downsample(format_, level, width, height, dirty, next);
+        }
+        auto dirtyWidth = dirty.right - dirty.left;
+        if (dirtyWidth != (int32_t)nextWidth)
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, nextWidth);
+        glTexSubImage2D(GL_TEXTURE_2D, i, dirty.left, dirty.bottom, dirtyWidth,
+            dirty.top - dirty.bottom, glFormat(format_), glType(format_),
+            next + (dirty.bottom * nextWidth + dirty.left) * pixelSize);
+        if (dirtyWidth != (int32_t)nextWidth)
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        level = next;
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
+
+void Texture::share(uint64_t hash, Image::Bytes bytes) {
+
+    shared_ = true;
+    hash_ = hash;
+    // the backing copy of the full upload becomes the shared content
+    if (backing_.size() == bytes.count)
+        bytes_.swap(backing_);
+    else
+        bytes_.assign(bytes.ptr, bytes.ptr + bytes.count);
+    backing_.clear();
+    backing_.shrink_to_fit();
+}
+
+void Texture::unshare() {
+
+    if (shared_) {
+        renderer_.releaseSharedTexture(hash_, this);
+        shared_ = false;
+        if (backing())
+            backing_.swap(bytes_);
+        bytes_.clear();
+        bytes_.shrink_to_fit();
+    }
+}
+
+Image::Bytes Texture::bytes() const {
+
+    return Image::Bytes(bytes_.data(), (uint32_t)bytes_.size());
+}
+
+bool Texture::equals(const Size& size, Image::Format format, bool filter, bool mipmaps,
+    Image::Bytes bytes) const {
+
+    return shared_ && size_ == size && format_ == format && filter_ == filter &&
+        mipmaps_ == mipmaps &&
+        bytes_.size() == bytes.count &&
+        memcmp(bytes_.data(), bytes.ptr, bytes.count) == 0;
+}
+
+PixelStream::PixelStream(RendererImpl& renderer, uint32_t frameSize,
+    uint32_t bufferCount, bool pixelBuffer) :
+    renderer_(renderer),
+    frameSize_(frameSize),
+    pixelBuffer_(pixelBuffer),
+    buffers_(bufferCount) {
+}
+
+PixelStream::~PixelStream() {
+
+    renderer_.setContext();
+
+    for (auto& buffer : buffers_) {
+        unmap(buffer);
+        if (pixelBuffer_)
+            glDeleteBuffers(1, &buffer.handle);
+    }
+}
+
+bool PixelStream::init() {
+
+    renderer_.setContext();
+
+    for (auto& buffer : buffers_) {
+        if (pixelBuffer_)
+            glGenBuffers(1, &buffer.handle);
+        else
+            buffer.memory.resize(frameSize_);
+        map(buffer);
+    }
+    if (pixelBuffer_)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
     if (glGetError() == GL_OUT_OF_MEMORY) {
         setError(OpenGLOutOfMemory);
@@ -80,20 +589,258 @@ bool ImageImpl::init() {
     return true;
 }
 
+void PixelStream::map(Buffer& buffer) {
+
+    if (pixelBuffer_) {
+        // orphan the storage, so mapping does not wait for a transfer in flight
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.handle);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, frameSize_, nullptr, GL_STREAM_DRAW);
+        buffer.ptr = static_cast<uint8_t*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
+    }
+    else {
+        buffer.ptr = buffer.memory.data();
+    }
+    buffer.state = buffer.ptr ? State::Mapped : State::Idle;
+}
+
+void PixelStream::unmap(Buffer& buffer) {
+
+    if (pixelBuffer_ && buffer.ptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.handle);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    buffer.ptr = nullptr;
+}
+
+uint8_t* PixelStream::lock() {
+
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    // one frame is written at a time, unlock has no buffer to tell which one ends
+    auto locked = std::any_of(std::begin(buffers_), std::end(buffers_),
+        [](const Buffer& buffer) { return buffer.state == State::Locked; });
+    auto it = locked ? buffers_.end() : std::find_if(std::begin(buffers_), std::end(buffers_),
+        [](const Buffer& buffer) { return buffer.state == State::Mapped; });
+    if (it == buffers_.end())
+        return nullptr;
+
+    it->state = State::Locked;
+    return it->ptr;
+}
+
+bool PixelStream::unlock() {
+
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    auto it = std::find_if(std::begin(buffers_), std::end(buffers_),
+        [](const Buffer& buffer) { return buffer.state == State::Locked; });
+    if (it == buffers_.end())
+        return false;
+
+    it->state = State::Filled;
+    it->frame = ++frame_;
+    return true;
+}
+
+uint32_t PixelStream::transfer(Texture& texture, const Size& size) {
+
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    Buffer* latest = nullptr;
+    for (auto& buffer : buffers_) {
+        if (buffer.state == State::Filled && (!latest || latest->frame < buffer.frame))
+            latest = &buffer;
+    }
+    if (!latest)
+        return 0;
+
+    // older frames are dropped, only the latest one is transferred
+    for (auto& buffer : buffers_) {
+        if (buffer.state == State::Filled) {
+            unmap(buffer);
+            buffer.state = State::Idle;
+        }
+    }
+    Rect region(0, 0, size.width, size.height);
+    if (pixelBuffer_) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, latest->handle);
+        texture.upload(region, Image::Bytes(nullptr, frameSize_), 0);
+    }
+    else {
+        texture.upload(region, Image::Bytes(latest->memory.data(), frameSize_), 0);
+    }
+    for (auto& buffer : buffers_) {
+        if (buffer.state == State::Idle)
+            map(buffer);
+    }
+    if (pixelBuffer_)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return frameSize_;
+}
+
+ImageImpl::ImageImpl(RendererImpl& renderer, const Size& size,
+    Image::Format format, bool filter, bool mipmaps, uint32_t bufferCount) :
+    renderer_(renderer),
+    size_(size),
+    format_(format),
+    filter_(filter),
+    mipmaps_(mipmaps),
+    bufferCount_(bufferCount) {
+}
+
+ImageImpl::~ImageImpl() {
+
+    if (stream_)
+        renderer_.unregisterStream(this);
+}
+
+bool ImageImpl::init() {
+
+    if (size_.width <= 0 || size_.width > Image::kMaxSize ||
+        size_.height <= 0 || size_.height > Image::kMaxSize ||
+        (stream() && (bufferCount_ < kMinStreamBuffers || bufferCount_ > kMaxStreamBuffers)) ||
+        (mipmaps_ && compressed(format_))) {
+        setError(InvalidArgument);
+        return false;
+    }
+    if (!renderer_.supports(format_)) {
+        setError(OpenGLAbsentFeature);
+        return false;
+    }
+    if (!makeTexture())
+        return false;
+    if (stream()) {
+        auto stream = make_unique<PixelStream>(renderer_,
+            byteSize(format_, size_.width, size_.height), bufferCount_, renderer_.pixelBuffer());
+        if (!stream->init())
+            return false;
+        stream_ = std::move(stream);
+        texture_->pin();
+        renderer_.registerStream(this);
+    }
+    return true;
+}
+
+uint32_t ImageImpl::transfer() {
+
+    ASSERT(stream_);
+    return stream_->transfer(*texture_, size_);
+}
+
+uint8_t* ImageImpl::lock() {
+
+    if (!stream_) {
+        setError(InvalidArgument);
+        return nullptr;
+    }
+    return stream_->lock();
+}
+
+void ImageImpl::unlock() {
+
+    if (!stream_ || !stream_->unlock())
+        setError(InvalidArgument);
+}
+
+bool ImageImpl::makeTexture() {
+
+    auto texture = std::make_shared<Texture>(renderer_, size_, format_, filter_, mipmaps_);
+    if (!texture->init())
+        return false;
+    texture_ = texture;
+    return true;
+}
+
+bool ImageImpl::checkBytes(Image::Bytes bytes) const {
+
+    return bytes.ptr &&
+        bytes.count == byteSize(format_, size_.width, size_.height);
+}
+
+bool ImageImpl::makePrivate(bool keepContent) {
+
+    if (!texture_->shared())
+        return true;
+    if (texture_.use_count() == 1) {
+        texture_->unshare();
+        return true;
+    }
+    auto shared = texture_;
+    if (!makeTexture())
+        return false;
+    if (keepContent) {
+        texture_->upload(Rect(0, 0, size_.width, size_.height), shared->bytes(), 0);
+    }
+    return true;
+}
+
 void ImageImpl::upload(Image::Bytes bytes) {
 
-    if (!bytes.ptr ||
-        bytes.count != uint32_t(size_.width * size_.height * bpp(format_))) {
+    TraceScope trace("Image::upload");
+    if (!checkBytes(bytes)) {
         setError(InvalidArgument);
         return;
     }
-    renderer_.setContext();
+    if (!makePrivate(false))
+        return;
+    texture_->upload(Rect(0, 0, size_.width, size_.height), bytes, 0);
+}
 
-    glBindTexture(GL_TEXTURE_2D, handle_);
-    glTexImage2D(GL_TEXTURE_2D, 0, glInternalFormat(format_), size_.width,
-        size_.height, 0, glFormat(format_), GL_UNSIGNED_BYTE, bytes.ptr);
+void ImageImpl::upload(const Rect& region, Image::Bytes bytes, uint32_t stride) {
 
-    ASSERT(glGetError() == GL_NO_ERROR);
+    TraceScope trace("Image::upload");
+    auto pixelSize = bpp(format_);
+    if (region.left < 0 || region.bottom < 0 ||
+        region.right > (int32_t)size_.width || region.top > (int32_t)size_.height ||
+        region.left >= region.right || region.bottom >= region.top) {
+        setError(InvalidArgument);
+        return;
+    }
+    auto width = uint32_t(region.right - region.left);
+    auto height = uint32_t(region.top - region.bottom);
+    if (compressed(format_)) {
+        const auto block = (int32_t)kBlockSize;
+        if (region.left % block != 0 || region.bottom % block != 0 ||
+            (region.right % block != 0 && region.right != (int32_t)size_.width) ||
+            (region.top % block != 0 && region.top != (int32_t)size_.height) ||
+            stride != 0 || !bytes.ptr || bytes.count < byteSize(format_, width, height)) {
+            setError(InvalidArgument);
+            return;
+        }
+        if (makePrivate(true))
+            texture_->upload(region, bytes, 0);
+        return;
+    }
+    // large strides of tall regions exceed 32 bits
+    auto rowSize = width * pixelSize;
+    if ((stride != 0 && (stride < rowSize || stride % pixelSize != 0)) || !bytes.ptr ||
+        bytes.count < (uint64_t)(stride != 0 ? stride : rowSize) * (height - 1) + rowSize) {
+        setError(InvalidArgument);
+        return;
+    }
+    if (!makePrivate(true))
+        return;
+    texture_->upload(region, bytes, stride / pixelSize);
+}
+
+void ImageImpl::uploadShared(Image::Bytes bytes) {
+
+    TraceScope trace("Image::uploadShared");
+    if (stream_ || !checkBytes(bytes)) {
+        setError(InvalidArgument);
+        return;
+    }
+    auto hash = hashImage(size_, format_, filter_, mipmaps_, bytes);
+    auto texture = renderer_.findSharedTexture(hash);
+    if (texture && texture->equals(size_, format_, filter_, mipmaps_, bytes)) {
+        texture_ = texture;
+        return;
+    }
+    if (!makePrivate(false))
+        return;
+    texture_->upload(Rect(0, 0, size_.width, size_.height), bytes, 0);
+    if (!texture)
+        renderer_.registerSharedTexture(hash, bytes, texture_);
 }
 
 } // namespace draw
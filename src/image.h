@@ -1,37 +1,165 @@
 #pragma once
 #include <draw.h>
 #include <GL/glew.h>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace draw {
 
 class RendererImpl;
 
+class Texture final {
+
+public:
+    Texture(RendererImpl& renderer, const Size& size, Image::Format format, bool filter,
+        bool mipmaps);
+    ~Texture();
+
+    Texture(const Texture&) = delete;
+    Texture& operator = (const Texture&) = delete;
+
+    bool init();
+    void upload(const Rect& region, Image::Bytes bytes, uint32_t rowLength);
+    GLuint handle() const { return handle_; }
+    GLuint use(uint64_t frame);
+    const Size& size() const { return size_; }
+    bool filter() const { return filter_; }
+    // RGBA copy of level 0 for Backend::Software
+    const std::vector<uint8_t>& texels() const { return texels_; }
+
+    uint64_t memory() const;
+    bool resident() const { return resident_; }
+    uint64_t lastUse() const { return lastUse_; }
+    void pin() { pinned_ = true; }
+    bool pinned() const { return pinned_; }
+    bool evict();
+
+    void share(uint64_t hash, Image::Bytes bytes);
+    void unshare();
+    bool shared() const { return shared_; }
+    bool equals(const Size& size, Image::Format format, bool filter, bool mipmaps,
+        Image::Bytes bytes) const;
+    Image::Bytes bytes() const;
+
+private:
+    bool create();
+    bool allocate();
+    bool restore(bool keepContent);
+    // private textures keep a CPU copy of level 0 to be evicted without a read back
+    bool backing() const;
+    void updateMipmaps(const Rect& region, Image::Bytes bytes, uint32_t rowLength);
+    void updateTexels(const Rect& region, Image::Bytes bytes, uint32_t rowLength);
+
+    RendererImpl& renderer_;
+    Size size_ {0, 0};
+    Image::Format format_ {Image::Format::RGB};
+    bool filter_ {false};
+    bool mipmaps_ {false};
+    GLuint handle_ {0};
+    bool shared_ {false};
+    uint64_t hash_ {0};
+    std::vector<uint8_t> bytes_;
+    // all mip levels filtered on CPU if glGenerateMipmap is absent
+    std::vector<uint8_t> levels_;
+    std::vector<uint8_t> backing_;
+    std::vector<uint8_t> texels_;
+    bool resident_ {false};
+    uint64_t lastUse_ {0};
+    bool pinned_ {false};
+};
+
+using TexturePtr = std::shared_ptr<Texture>;
+
+class PixelStream final {
+
+public:
+    PixelStream(RendererImpl& renderer, uint32_t frameSize, uint32_t bufferCount,
+        bool pixelBuffer);
+    ~PixelStream();
+
+    PixelStream(const PixelStream&) = delete;
+    PixelStream& operator = (const PixelStream&) = delete;
+
+    bool init();
+    uint8_t* lock();
+    bool unlock();
+    uint32_t transfer(Texture& texture, const Size& size);
+
+private:
+    enum class State {
+
+        Idle,
+        Mapped,
+        Locked,
+        Filled
+    };
+
+    struct Buffer {
+
+        GLuint handle {0};
+        std::vector<uint8_t> memory;
+        uint8_t* ptr {nullptr};
+        State state {State::Idle};
+        uint64_t frame {0};
+    };
+
+    void map(Buffer& buffer);
+    void unmap(Buffer& buffer);
+
+    RendererImpl& renderer_;
+    uint32_t frameSize_ {0};
+    bool pixelBuffer_ {false};
+    std::vector<Buffer> buffers_;
+    uint64_t frame_ {0};
+    std::mutex mutex_;
+};
+
+using PixelStreamPtr = std::unique_ptr<PixelStream>;
+
 class ImageImpl final : public Image {
 
 public:
-    ImageImpl(RendererImpl& renderer, const Size& size, Format format, bool filter);
+    ImageImpl(RendererImpl& renderer, const Size& size, Format format, bool filter,
+        bool mipmaps, uint32_t bufferCount = 0);
     virtual ~ImageImpl();
 
     ImageImpl(const ImageImpl&) = delete;
     ImageImpl& operator = (const ImageImpl&) = delete;
 
     bool init();
-    GLuint handle() { return handle_; }
+    GLuint use(uint64_t frame) { return texture_->use(frame); }
+    const Texture* texture() const { return texture_.get(); }
+    uint32_t transfer();
 
     // Image
 
     virtual const Size& size() const final { return size_; }
     virtual Format format() const final { return format_; }
     virtual bool filter() const final { return filter_; }
+    virtual bool mipmaps() const final { return mipmaps_; }
 
     virtual void upload(Bytes bytes) final;
+    virtual void upload(const Rect& region, Bytes bytes, uint32_t stride) final;
+    virtual void uploadShared(Bytes bytes) final;
+
+    virtual bool stream() const final { return bufferCount_ > 0; }
+    virtual uint8_t* lock() final;
+    virtual void unlock() final;
 
 private:
+    bool checkBytes(Bytes bytes) const;
+    bool makeTexture();
+    bool makePrivate(bool keepContent);
+
     RendererImpl& renderer_;
     Size size_ {0, 0};
     Format format_ {Format::RGB};
     bool filter_ {false};
-    GLuint handle_ {0};
+    bool mipmaps_ {false};
+    uint32_t bufferCount_ {0};
+    TexturePtr texture_;
+    PixelStreamPtr stream_;
 };
 
 } // namespace draw
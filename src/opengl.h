@@ -5,3 +5,4 @@
 #else
 #include <GL/glew.h>
 #endif
+#include <backend.h>
@@ -0,0 +1,440 @@
+#include "raster.h"
+#include <geometry.h>
+#include <image.h>
+#include <agg_rasterizer_scanline_aa.h>
+#include <agg_scanline_u.h>
+#include <agg_gamma_functions.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace draw {
+
+inline uint8_t mul(uint32_t left, uint32_t right) {
+
+    return uint8_t((left * right + 127) / 255);
+}
+
+// fragment shaders of the OpenGL programs
+class Shader final {
+
+public:
+    Shader(FillMode fillMode, const Texture& texture, Color color) :
+        fillMode_(fillMode),
+        texels_(texture.texels().data()),
+        width_((int)texture.size().width),
+        height_((int)texture.size().height),
+        filter_(texture.filter()) {
+
+        // vertex attributes read color bytes in memory order
+        memcpy(color_, &color, sizeof(color_));
+        uniform_ = width_ == 1 && height_ == 1;
+        if (uniform_)
+            combine(texels_, uniformColor_);
+    }
+
+    // the color does not depend on texture coordinates (e.g. shapes without an image)
+    bool uniform() const { return uniform_; }
+
+    // texture coordinates step per pixel, fwidth of distance fonts is taken over it
+    void pixelStep(float du, float dv) {
+
+        du_ = du;
+        dv_ = dv;
+    }
+
+    void shade(float u, float v, uint8_t* dst) const {
+
+        uint8_t texel[4], src[4];
+        if (fillMode_ == FillMode::DistanceFont)
+            sampleDistance(u, v, texel);
+        else if (filter_)
+            sampleLinear(u, v, texel);
+        else
+            sampleNearest(u, v, texel);
+        combine(texel, src);
+        write(src, dst);
+    }
+
+    void shadeUniform(uint8_t* dst, int32_t count) const {
+
+        for (int32_t i = 0; i < count; ++i, dst += 4)
+            write(uniformColor_, dst);
+    }
+
+private:
+    void combine(const uint8_t* texel, uint8_t* src) const {
+
+        if (fillMode_ == FillMode::Font || fillMode_ == FillMode::DistanceFont) {
+            src[0] = color_[0];
+            src[1] = color_[1];
+            src[2] = color_[2];
+            src[3] = mul(color_[3], texel[3]);
+        }
+        else {
+            for (int i = 0; i < 4; ++i)
+                src[i] = mul(color_[i], texel[i]);
+        }
+    }
+
+    void write(const uint8_t* src, uint8_t* dst) const {
+
+        if (fillMode_ == FillMode::Solid) {
+            memcpy(dst, src, 4);
+            return;
+        }
+        // glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) for all channels
+        uint32_t alpha = src[3], inverse = 255 - alpha;
+        for (int i = 0; i < 4; ++i)
+            dst[i] = uint8_t((src[i] * alpha + dst[i] * inverse + 127) / 255);
+    }
+
+    // GL_REPEAT wrapping
+    int wrap(int value, int size) const {
+
+        value %= size;
+        return value < 0 ? value + size : value;
+    }
+
+    const uint8_t* texel(int x, int y) const {
+
+        return texels_ + (wrap(y, height_) * width_ + wrap(x, width_)) * 4;
+    }
+
+    void sampleNearest(float u, float v, uint8_t* out) const {
+
+        memcpy(out, texel((int)std::floor(u * width_), (int)std::floor(v * height_)), 4);
+    }
+
+    void sampleLinear(float u, float v, uint8_t* out) const {
+
+        auto x = u * width_ - 0.5f, y = v * height_ - 0.5f;
+        auto x0 = std::floor(x), y0 = std::floor(y);
+        auto ax = uint32_t((x - x0) * 256.0f), ay = uint32_t((y - y0) * 256.0f);
+        auto* t00 = texel((int)x0, (int)y0);
+        auto* t10 = texel((int)x0 + 1, (int)y0);
+        auto* t01 = texel((int)x0, (int)y0 + 1);
+        auto* t11 = texel((int)x0 + 1, (int)y0 + 1);
+        for (int i = 0; i < 4; ++i) {
+            auto bottom = t00[i] * (256 - ax) + t10[i] * ax;
+            auto top = t01[i] * (256 - ax) + t11[i] * ax;
+            out[i] = uint8_t((bottom * (256 - ay) + top * ay + 32768) >> 16);
+        }
+    }
+
+    // smoothstep(0.5 - width, 0.5 + width, distance) as alpha
+    void sampleDistance(float u, float v, uint8_t* out) const {
+
+        uint8_t texel[4];
+        sampleLinear(u, v, texel);
+        auto distance = texel[3] / 255.0f;
+        sampleLinear(u + du_, v, texel);
+        auto dx = texel[3] / 255.0f - distance;
+        sampleLinear(u, v + dv_, texel);
+        auto dy = texel[3] / 255.0f - distance;
+        auto width = 0.5f * (std::fabs(dx) + std::fabs(dy));
+
+        auto alpha = distance < 0.5f ? 0.0f : 1.0f;
+        if (width > 0.0f) {
+            auto t = std::min(std::max((distance - 0.5f + width) / (2.0f * width), 0.0f), 1.0f);
+            alpha = t * t * (3.0f - 2.0f * t);
+        }
+        memset(out, 0xFF, 3);
+        out[3] = uint8_t(alpha * 255.0f + 0.5f);
+    }
+
+    FillMode fillMode_;
+    const uint8_t* texels_;
+    int width_;
+    int height_;
+    bool filter_;
+    bool uniform_;
+    uint8_t color_[4];
+    uint8_t uniformColor_[4];
+    float du_ {0.0f};
+    float dv_ {0.0f};
+};
+
+// draws items of a tile, every thread has its own AGG rasterizer
+class TileRenderer final {
+
+public:
+    TileRenderer(uint8_t* frame, const Size& size) :
+        frame_(frame),
+        width_(size.width) {
+
+        // pixels are covered or not like on the GPU, so triangles sharing an edge have no seams
+        rasterizer_.gamma(agg::gamma_threshold(0.5));
+    }
+
+    void draw(const Rect& tile, const std::vector<Rasterizer::Command>& commands,
+        const std::vector<Rasterizer::Item>& items, const std::vector<uint32_t>& bin) {
+
+        tile_ = tile;
+        rasterizer_.clip_box(tile.left, tile.bottom, tile.right, tile.top);
+        for (auto index : bin) {
+            const auto& item = items[index];
+            const auto& command = commands[item.command];
+            drawItem(command, item.instance);
+        }
+    }
+
+private:
+    void drawItem(const Rasterizer::Command& command, const Instance& instance) {
+
+        const auto& geometry = *command.geometry;
+        const auto* page = geometry.page();
+        const auto* vertices = page->vertexData.data() + geometry.baseVertex();
+        const auto* indices = page->indexData.data() + geometry.firstIndex();
+        auto count = geometry.indexCount();
+        Shader shader(command.fillMode, *command.texture, instance.color);
+        if (command.fillMode == FillMode::DistanceFont && instance.posFrame.z != 0.0f &&
+            instance.posFrame.w != 0.0f) {
+            shader.pixelStep(std::fabs(instance.uvFrame.z / instance.posFrame.z),
+                std::fabs(instance.uvFrame.w / instance.posFrame.w));
+        }
+
+        auto transform = [&instance, vertices](Geometry::Index index, Vector2& pos, Vector2& uv) {
+            const auto& vertex = vertices[index];
+            const auto& posFrame = instance.posFrame;
+            const auto& uvFrame = instance.uvFrame;
+            pos.x = vertex.position.x * posFrame.z + posFrame.x;
+            pos.y = vertex.position.y * posFrame.w + posFrame.y;
+            uv.x = vertex.uv.x * uvFrame.z + uvFrame.x;
+            uv.y = vertex.uv.y * uvFrame.w + uvFrame.y;
+        };
+
+        Vector2 pos[3], uv[3];
+        switch (geometry.primitive()) {
+        case Geometry::Primitive::Triangle:
+            if (shader.uniform() && command.fillMode == FillMode::Solid) {
+                // every pixel is written once with the same color, so the whole
+                // mesh is swept at once
+                rasterizer_.reset();
+                for (uint32_t i = 0; i + 2 < count; i += 3) {
+                    for (uint32_t j = 0; j < 3; ++j)
+                        transform(indices[i + j], pos[j], uv[j]);
+                    rasterizer_.move_to_d(pos[0].x, pos[0].y);
+                    rasterizer_.line_to_d(pos[1].x, pos[1].y);
+                    rasterizer_.line_to_d(pos[2].x, pos[2].y);
+                }
+                fillUniform(shader);
+                break;
+            }
+            for (uint32_t i = 0; i + 2 < count; i += 3) {
+                for (uint32_t j = 0; j < 3; ++j)
+                    transform(indices[i + j], pos[j], uv[j]);
+                triangle(pos, uv, shader);
+            }
+            break;
+        case Geometry::Primitive::Line:
+            for (uint32_t i = 0; i + 1 < count; i += 2) {
+                for (uint32_t j = 0; j < 2; ++j)
+                    transform(indices[i + j], pos[j], uv[j]);
+                line(pos, uv, shader);
+            }
+            break;
+        case Geometry::Primitive::Point:
+            for (uint32_t i = 0; i < count; ++i) {
+                transform(indices[i], pos[0], uv[0]);
+                point(pos[0], uv[0], shader);
+            }
+            break;
+        }
+    }
+
+    void fillUniform(const Shader& shader) {
+
+        fill([&shader](int32_t, int32_t first, int32_t last, uint8_t* dst) {
+            shader.shadeUniform(dst, last - first);
+        });
+    }
+
+    template <typename Fragment>
+    void fillPixels(const Shader& shader, Fragment&& fragment) {
+
+        if (shader.uniform())
+            return fillUniform(shader);
+        fill([&fragment](int32_t y, int32_t first, int32_t last, uint8_t* dst) {
+            for (auto x = first; x < last; ++x, dst += 4)
+                fragment(x + 0.5f, y + 0.5f, dst);
+        });
+    }
+
+    // calls the span function for covered pixels of every row inside of the tile
+    template <typename Span>
+    void fill(Span&& span) {
+
+        if (!rasterizer_.rewind_scanlines())
+            return;
+        scanline_.reset(rasterizer_.min_x(), rasterizer_.max_x());
+        while (rasterizer_.sweep_scanline(scanline_)) {
+            auto y = scanline_.y();
+            if (y < tile_.bottom || y >= tile_.top)
+                continue;
+            auto count = scanline_.num_spans();
+            auto it = scanline_.begin();
+            for (;; ++it) {
+                auto first = std::max((int32_t)it->x, tile_.left);
+                auto last = std::min((int32_t)it->x + it->len, tile_.right);
+                if (first < last)
+                    span(y, first, last, frame_ + ((size_t)y * width_ + first) * 4);
+                if (--count == 0)
+                    break;
+            }
+        }
+    }
+
+    void triangle(const Vector2* pos, const Vector2* uv, const Shader& shader) {
+
+        auto e1x = pos[1].x - pos[0].x, e1y = pos[1].y - pos[0].y;
+        auto e2x = pos[2].x - pos[0].x, e2y = pos[2].y - pos[0].y;
+        auto area = e1x * e2y - e2x * e1y;
+        if (std::fabs(area) < 1e-6f)
+            return;
+
+        rasterizer_.reset();
+        rasterizer_.move_to_d(pos[0].x, pos[0].y);
+        rasterizer_.line_to_d(pos[1].x, pos[1].y);
+        rasterizer_.line_to_d(pos[2].x, pos[2].y);
+
+        // barycentric weights of the 2nd and 3rd vertices
+        fillPixels(shader, [&](float x, float y, uint8_t* dst) {
+            auto dx = x - pos[0].x, dy = y - pos[0].y;
+            auto w1 = (dx * e2y - dy * e2x) / area, w2 = (e1x * dy - e1y * dx) / area;
+            shader.shade(
+                uv[0].x + w1 * (uv[1].x - uv[0].x) + w2 * (uv[2].x - uv[0].x),
+                uv[0].y + w1 * (uv[1].y - uv[0].y) + w2 * (uv[2].y - uv[0].y), dst);
+        });
+    }
+
+    void line(const Vector2* pos, const Vector2* uv, const Shader& shader) {
+
+        auto dx = pos[1].x - pos[0].x, dy = pos[1].y - pos[0].y;
+        auto length2 = dx * dx + dy * dy;
+        if (length2 < 1e-6f)
+            return point(pos[0], uv[0], shader);
+
+        // one pixel wide quad along the line
+        auto scale = 0.5f / std::sqrt(length2);
+        auto nx = -dy * scale, ny = dx * scale;
+        rasterizer_.reset();
+        rasterizer_.move_to_d(pos[0].x + nx, pos[0].y + ny);
+        rasterizer_.line_to_d(pos[1].x + nx, pos[1].y + ny);
+        rasterizer_.line_to_d(pos[1].x - nx, pos[1].y - ny);
+        rasterizer_.line_to_d(pos[0].x - nx, pos[0].y - ny);
+
+        fillPixels(shader, [&](float x, float y, uint8_t* dst) {
+            auto t = std::min(std::max(((x - pos[0].x) * dx + (y - pos[0].y) * dy) / length2,
+                0.0f), 1.0f);
+            shader.shade(uv[0].x + t * (uv[1].x - uv[0].x),
+                uv[0].y + t * (uv[1].y - uv[0].y), dst);
+        });
+    }
+
+    void point(const Vector2& pos, const Vector2& uv, const Shader& shader) {
+
+        rasterizer_.reset();
+        rasterizer_.move_to_d(pos.x - 0.5f, pos.y - 0.5f);
+        rasterizer_.line_to_d(pos.x + 0.5f, pos.y - 0.5f);
+        rasterizer_.line_to_d(pos.x + 0.5f, pos.y + 0.5f);
+        rasterizer_.line_to_d(pos.x - 0.5f, pos.y + 0.5f);
+
+        fillPixels(shader, [&](float, float, uint8_t* dst) { shader.shade(uv.x, uv.y, dst); });
+    }
+
+    uint8_t* frame_;
+    uint32_t width_;
+    Rect tile_;
+    agg::rasterizer_scanline_aa<> rasterizer_;
+    agg::scanline_u8 scanline_;
+};
+
+Rasterizer::Rasterizer(WorkerPool& workers) :
+    workers_(workers) {
+}
+
+void Rasterizer::begin(const Size& size, Color clear) {
+
+    size_ = size;
+    frame_.resize((size_t)size_.width * size_.height * 4);
+    clear_[0] = uint8_t(clear >> 24);
+    clear_[1] = uint8_t(clear >> 16);
+    clear_[2] = uint8_t(clear >> 8);
+    clear_[3] = uint8_t(clear);
+
+    commands_.clear();
+    items_.clear();
+    columns_ = (size_.width + kTileSize - 1) / kTileSize;
+    rows_ = (size_.height + kTileSize - 1) / kTileSize;
+    bins_.resize(columns_ * rows_);
+    for (auto& bin : bins_)
+        bin.clear();
+}
+
+void Rasterizer::draw(FillMode fillMode, const GeometryImpl& geometry, const Texture& texture,
+    const Instance* instances, uint32_t count) {
+
+    auto command = (uint32_t)commands_.size();
+    commands_.emplace_back(fillMode, &geometry, &texture);
+
+    const auto& bounds = geometry.bounds();
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto& posFrame = instances[i].posFrame;
+        auto left = posFrame.x + bounds.x * posFrame.z, right = posFrame.x + bounds.z * posFrame.z;
+        auto bottom = posFrame.y + bounds.y * posFrame.w, top = posFrame.y + bounds.w * posFrame.w;
+
+        // lines and points are one pixel wide around their vertices
+        auto x0 = std::max(std::floor(std::min(left, right) - 1.0f), 0.0f);
+        auto y0 = std::max(std::floor(std::min(bottom, top) - 1.0f), 0.0f);
+        auto x1 = std::min(std::max(left, right) + 1.0f, (float)size_.width - 1);
+        auto y1 = std::min(std::max(bottom, top) + 1.0f, (float)size_.height - 1);
+        if (x0 > x1 || y0 > y1)
+            continue;
+
+        auto index = (uint32_t)items_.size();
+        items_.emplace_back();
+        items_.back().instance = instances[i];
+        items_.back().command = command;
+        for (auto row = (uint32_t)y0 / kTileSize; row <= (uint32_t)y1 / kTileSize; ++row) {
+            for (auto column = (uint32_t)x0 / kTileSize; column <= (uint32_t)x1 / kTileSize;
+                ++column)
+                bins_[row * columns_ + column].push_back(index);
+        }
+    }
+}
+
+void Rasterizer::end() {
+
+    // the thread calling Renderer::draw works too
+    nextTile_ = 0;
+    workers_.run(workers_.threadCount(), [this](uint32_t) { work(); });
+}
+
+Image::Bytes Rasterizer::pixels() const {
+
+    return Image::Bytes(frame_.data(), (uint32_t)frame_.size());
+}
+
+void Rasterizer::work() {
+
+    TileRenderer renderer(frame_.data(), size_);
+    auto tileCount = (uint32_t)bins_.size();
+    for (auto tile = nextTile_++; tile < tileCount; tile = nextTile_++) {
+        auto left = (tile % columns_) * kTileSize, bottom = (tile / columns_) * kTileSize;
+        Rect rect(left, bottom, std::min(left + kTileSize, size_.width),
+            std::min(bottom + kTileSize, size_.height));
+
+        // tiles are cleared in parallel too, the first row is copied to the others
+        auto* first = &frame_[((size_t)rect.bottom * size_.width + rect.left) * 4];
+        auto rowSize = (rect.right - rect.left) * 4;
+        for (auto x = 0; x < rowSize; x += 4)
+            memcpy(first + x, clear_, sizeof(clear_));
+        for (auto y = rect.bottom + 1; y < rect.top; ++y)
+            memcpy(&frame_[((size_t)y * size_.width + rect.left) * 4], first, rowSize);
+        if (!bins_[tile].empty())
+            renderer.draw(rect, commands_, items_, bins_[tile]);
+    }
+}
+
+} // namespace draw
@@ -0,0 +1,67 @@
+#pragma once
+#include <draw.h>
+#include <common.h>
+#include <workers.h>
+#include <atomic>
+#include <vector>
+
+namespace draw {
+
+class GeometryImpl;
+class Texture;
+
+// CPU renderer of Backend::Software, the frame is split into tiles drawn in parallel
+class Rasterizer final {
+
+public:
+    explicit Rasterizer(WorkerPool& workers);
+
+    Rasterizer(const Rasterizer&) = delete;
+    Rasterizer& operator = (const Rasterizer&) = delete;
+
+    void begin(const Size& size, Color clear);
+    void draw(FillMode fillMode, const GeometryImpl& geometry, const Texture& texture,
+        const Instance* instances, uint32_t count);
+    void end();
+
+    // RGBA rows from bottom to top, like glReadPixels returns them
+    Image::Bytes pixels() const;
+
+    struct Command {
+
+        FillMode fillMode;
+        const GeometryImpl* geometry;
+        const Texture* texture;
+
+        Command(FillMode fillMode, const GeometryImpl* geometry, const Texture* texture) :
+            fillMode(fillMode), geometry(geometry), texture(texture) {}
+    };
+
+    struct Item {
+
+        Instance instance;
+        uint32_t command {0};
+    };
+
+private:
+    static const uint32_t kTileSize {128};
+
+    void work();
+
+    Size size_ {0, 0};
+    std::vector<uint8_t> frame_;
+    uint8_t clear_[4];
+    std::vector<Command> commands_;
+    std::vector<Item> items_;
+    uint32_t columns_ {0};
+    uint32_t rows_ {0};
+    // indices of items overlapping each tile in the draw order
+    std::vector<std::vector<uint32_t>> bins_;
+
+    WorkerPool& workers_;
+    std::atomic<uint32_t> nextTile_ {0};
+};
+
+using RasterizerPtr = std::unique_ptr<Rasterizer>;
+
+} // namespace draw
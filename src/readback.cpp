@@ -0,0 +1,145 @@
+#include "readback.h"
+#include <renderer.h>
+#include <error.h>
+
+namespace draw {
+
+Framebuffer::Framebuffer(RendererImpl& renderer) :
+    renderer_(renderer) {
+}
+
+Framebuffer::~Framebuffer() {
+
+    renderer_.setContext();
+
+    if (framebuffer_ != 0)
+        glDeleteFramebuffers(1, &framebuffer_);
+    if (colorBuffer_ != 0)
+        glDeleteRenderbuffers(1, &colorBuffer_);
+}
+
+bool Framebuffer::resize(const Size& size) {
+
+    renderer_.setContext();
+
+    if (framebuffer_ == 0) {
+        glGenFramebuffers(1, &framebuffer_);
+        glGenRenderbuffers(1, &colorBuffer_);
+    }
+    // there is no depth buffer, as frames are drawn without depth writes
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.width, size.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    bind();
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_RENDERBUFFER, colorBuffer_);
+    auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    unbind();
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        setError(OpenGLOutOfMemory);
+        return false;
+    }
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        setError(OpenGLAbsentFeature);
+        return false;
+    }
+    return true;
+}
+
+void Framebuffer::bind() {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+}
+
+void Framebuffer::unbind() {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+PixelReader::PixelReader(RendererImpl& renderer, bool pixelBuffer, bool sync) :
+    renderer_(renderer),
+    pixelBuffer_(pixelBuffer),
+    sync_(sync) {
+}
+
+PixelReader::~PixelReader() {
+
+    renderer_.setContext();
+
+    // pending reads are dropped, their callbacks may refer to objects already gone
+    for (auto& read : reads_) {
+        if (read.fence)
+            glDeleteSync(read.fence);
+        freeBuffers_.push_back(read.buffer);
+    }
+    if (!freeBuffers_.empty())
+        glDeleteBuffers((GLsizei)freeBuffers_.size(), freeBuffers_.data());
+}
+
+void PixelReader::read(const Size& size, PixelsCallback callback) {
+
+    auto byteCount = size.width * size.height * 4;
+    if (!pixelBuffer_) {
+        // without pixel buffers the copy waits for the frame to be drawn
+        memory_.resize(byteCount);
+        glReadPixels(0, 0, size.width, size.height, GL_RGBA, GL_UNSIGNED_BYTE, memory_.data());
+        callback(Image::Bytes(memory_.data(), byteCount), size);
+        return;
+    }
+
+    Read read;
+    if (freeBuffers_.empty()) {
+        glGenBuffers(1, &read.buffer);
+    }
+    else {
+        read.buffer = freeBuffers_.back();
+        freeBuffers_.pop_back();
+    }
+    read.frame = renderer_.frame();
+    read.size = size;
+    read.callback = std::move(callback);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, byteCount, nullptr, GL_STREAM_READ);
+    glReadPixels(0, 0, size.width, size.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (sync_)
+        read.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    reads_.push_back(std::move(read));
+}
+
+void PixelReader::collect(bool wait) {
+
+    while (!reads_.empty() && ready(reads_.front(), wait)) {
+        auto read = std::move(reads_.front());
+        reads_.pop_front();
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer);
+        auto* pixels = static_cast<const uint8_t*>(
+            glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+        read.callback(Image::Bytes(pixels, pixels ? read.size.width * read.size.height * 4 : 0),
+            read.size);
+        if (pixels)
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (read.fence)
+            glDeleteSync(read.fence);
+        freeBuffers_.push_back(read.buffer);
+    }
+}
+
+bool PixelReader::ready(const Read& read, bool wait) const {
+
+    if (!read.fence)
+        return wait || renderer_.frame() >= read.frame + kLatency;
+
+    auto status = wait ?
+        glClientWaitSync(read.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED) :
+        glClientWaitSync(read.fence, 0, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+} // namespace draw
@@ -0,0 +1,72 @@
+#pragma once
+#include <draw.h>
+#include <opengl.h>
+#include <deque>
+#include <vector>
+
+namespace draw {
+
+class RendererImpl;
+
+// color buffer frames are drawn into instead of the screen (see Renderer::offscreen)
+class Framebuffer final {
+
+public:
+    explicit Framebuffer(RendererImpl& renderer);
+    ~Framebuffer();
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator = (const Framebuffer&) = delete;
+
+    bool resize(const Size& size);
+    void bind();
+    void unbind();
+
+private:
+    RendererImpl& renderer_;
+    GLuint framebuffer_ {0};
+    GLuint colorBuffer_ {0};
+};
+
+using FramebufferPtr = std::unique_ptr<Framebuffer>;
+
+// copies frames to pixel buffers and maps them once fences say the copies are done
+class PixelReader final {
+
+public:
+    PixelReader(RendererImpl& renderer, bool pixelBuffer, bool sync);
+    ~PixelReader();
+
+    PixelReader(const PixelReader&) = delete;
+    PixelReader& operator = (const PixelReader&) = delete;
+
+    void read(const Size& size, PixelsCallback callback);
+    // calls callbacks of finished reads in the order they were requested
+    void collect(bool wait);
+
+private:
+    // without fences a read is mapped this count of frames later, when it is likely done
+    static const uint64_t kLatency = 2;
+
+    struct Read {
+
+        GLuint buffer {0};
+        GLsync fence {nullptr};
+        uint64_t frame {0};
+        Size size {0, 0};
+        PixelsCallback callback;
+    };
+
+    bool ready(const Read& read, bool wait) const;
+
+    RendererImpl& renderer_;
+    bool pixelBuffer_ {false};
+    bool sync_ {false};
+    std::deque<Read> reads_;
+    std::vector<GLuint> freeBuffers_;
+    std::vector<uint8_t> memory_;
+};
+
+using PixelReaderPtr = std::unique_ptr<PixelReader>;
+
+} // namespace draw
@@ -5,7 +5,9 @@
 #include <font.h>
 #include <shape.h>
 #include <text.h>
+#include <trace.h>
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 
 namespace draw {
@@ -173,10 +175,40 @@ static const char* kFontFS = R"(
     }
 )";
 
+// the outline lies at 0.5 of the distance, it is smoothed over a pixel at any scale
+static const char* kDistanceFontFS = R"(
+
+    #extension GL_OES_standard_derivatives : enable
+    precision highp float;
+    uniform sampler2D image;
+    varying vec2 vUV;
+    varying vec4 vColor;
+
+    void main() {
+        float distance = texture2D(image, vUV).a;
+        float width = 0.5 * fwidth(distance);
+        gl_FragColor = vec4(vColor.rgb,
+            vColor.a * smoothstep(0.5 - width, 0.5 + width, distance));
+    }
+)";
+
 } // namespace shaders
 
-RendererImpl::RendererImpl(ContextPtr context) :
-    context_(std::move(context)) {
+RendererImpl::RendererImpl(ContextPtr context, Backend backend) :
+    context_(std::move(context)),
+    gl_(getGLFunctions(backend)) {
+
+    if (backend == Backend::Counting) {
+        glCalls_.resize(kGLFunctionCount);
+        for (size_t i = 0; i < glCalls_.size(); ++i)
+            glCalls_[i].function = getGLFunctionName((GLFunction)i);
+    }
+    if (backend == Backend::Software) {
+        rasterizer_ = make_unique<Rasterizer>(workers());
+    }
+
+    staticArena_ = make_unique<GeometryArena>(*this, Geometry::Usage::Static);
+    dynamicArena_ = make_unique<GeometryArena>(*this, Geometry::Usage::Dynamic);
 }
 
 RendererImpl::~RendererImpl() {
@@ -186,6 +218,27 @@ RendererImpl::~RendererImpl() {
 
     setContext();
     glDeleteBuffers(1, &glBuffer_);
+
+    // release OpenGL objects before the counters are gone
+    distanceFontProgram_.reset();
+    fontProgram_.reset();
+    geometryProgram_.reset();
+    gpuTimer_.reset();
+    pixelReader_.reset();
+    framebuffer_.reset();
+    stubImage_.reset();
+    rectGeometry_.reset();
+    dynamicArena_.reset();
+    staticArena_.reset();
+    gGLCalls = nullptr;
+}
+
+void RendererImpl::setContext() {
+
+    if (context_)
+        context_->setCurrent();
+    gGL = &gl_;
+    gGLCalls = glCalls_.empty() ? nullptr : glCalls_.data();
 }
 
 bool RendererImpl::init() {
@@ -196,6 +249,21 @@ bool RendererImpl::init() {
         setError(OpenGLAbsentFeature);
         return false;
     }
+    baseVertex_ = glewIsSupported("GL_ARB_draw_elements_base_vertex") != GL_FALSE;
+    pixelBuffer_ = glewIsSupported("GL_ARB_pixel_buffer_object") != GL_FALSE;
+    framebufferObject_ = glewIsSupported("GL_VERSION_3_0") != GL_FALSE ||
+        glewIsSupported("GL_ARB_framebuffer_object") != GL_FALSE;
+    generateMipmap_ = framebufferObject_;
+    etc2_ = glewIsSupported("GL_ARB_ES3_compatibility") != GL_FALSE;
+    s3tc_ = glewIsSupported("GL_EXT_texture_compression_s3tc") != GL_FALSE;
+    bptc_ = glewIsSupported("GL_ARB_texture_compression_bptc") != GL_FALSE;
+    timerQuery_ = glewIsSupported("GL_ARB_timer_query") != GL_FALSE;
+    sync_ = glewIsSupported("GL_ARB_sync") != GL_FALSE;
+    if (rasterizer_) {
+        // the rasterizer decodes neither compressed formats nor GPU timings
+        etc2_ = s3tc_ = bptc_ = timerQuery_ = false;
+    }
+
     glDisable(GL_DITHER);
     glDisable(GL_STENCIL_TEST);
 
@@ -223,6 +291,7 @@ bool RendererImpl::init() {
     using namespace shaders;
     geometryProgram_ = make_unique<Program>(*this, kVS, kGeomFS);
     fontProgram_ = make_unique<Program>(*this, kVS, kFontFS);
+    distanceFontProgram_ = make_unique<Program>(*this, kVS, kDistanceFontFS);
 
     if (glGetError() == GL_OUT_OF_MEMORY) {
         setError(OpenGLOutOfMemory);
@@ -232,6 +301,11 @@ bool RendererImpl::init() {
     return true;
 }
 
+GeometryArena& RendererImpl::arena(Geometry::Usage usage) {
+
+    return usage == Geometry::Usage::Dynamic ? *dynamicArena_ : *staticArena_;
+}
+
 bool RendererImpl::resizeDataBuffer(uint32_t size) {
 
     setContext();
@@ -250,12 +324,12 @@ bool RendererImpl::resizeDataBuffer(uint32_t size) {
 
 Instance* RendererImpl::add(const Key& key) {
 
-    auto& batch = batches_[key];
-    batch.emplace_back(make_unique<Instance>());
-    if (batch.size() > dataBuffer_.size())
+    auto& instances = batches_[key].instances;
+    instances.emplace_back(make_unique<Instance>());
+    if (instances.size() > dataBuffer_.size())
         resizeDataBuffer(dataBuffer_.size() * kDataGrowthFactor);
 
-    return batch.back().get();
+    return instances.back().get();
 }
 
 void RendererImpl::remove(const Key& key, Instance* instance) {
@@ -263,16 +337,36 @@ void RendererImpl::remove(const Key& key, Instance* instance) {
     auto it = batches_.find(key);
     ASSERT(it != batches_.end() && "batch is not exist");
 
-    auto& batch = it->second;
-    auto itInst = std::find_if(std::begin(batch), std::end(batch),
+    auto& instances = it->second.instances;
+    auto itInst = std::find_if(std::begin(instances), std::end(instances),
         [&instance](const InstancePtr& e) { return instance == e.get(); });
-    ASSERT(itInst != batch.end() && "instance is not exist");
+    ASSERT(itInst != instances.end() && "instance is not exist");
 
-    auto index = std::distance(std::begin(batch), itInst);
-    batch[index] = std::move(batch[batch.size() - 1]);
-    batch.resize(batch.size() - 1);
+    *itInst = std::move(instances.back());
+    instances.pop_back();
 
-    if (batch.empty())
+    if (it->second.empty())
+        batches_.erase(it);
+}
+
+void RendererImpl::addRun(const Key& key, const InstanceRun* run) {
+
+    batches_[key].runs.push_back(run);
+}
+
+void RendererImpl::removeRun(const Key& key, const InstanceRun* run) {
+
+    auto it = batches_.find(key);
+    ASSERT(it != batches_.end() && "batch is not exist");
+
+    auto& runs = it->second.runs;
+    auto itRun = std::find(std::begin(runs), std::end(runs), run);
+    ASSERT(itRun != runs.end() && "run is not exist");
+
+    *itRun = runs.back();
+    runs.pop_back();
+
+    if (it->second.empty())
         batches_.erase(it);
 }
 
@@ -284,6 +378,8 @@ Program* RendererImpl::getProgram(FillMode fillMode) {
         return geometryProgram_.get();
     case FillMode::Font:
         return fontProgram_.get();
+    case FillMode::DistanceFont:
+        return distanceFontProgram_.get();
     }
     return nullptr;
 }
@@ -298,6 +394,7 @@ inline void setupFillMode(FillMode fillMode) {
         break;
     case FillMode::Transparent:
     case FillMode::Font:
+    case FillMode::DistanceFont:
         glEnable(GL_DEPTH_TEST);
         glDepthMask(GL_FALSE);
         glEnable(GL_BLEND);
@@ -313,10 +410,11 @@ inline void bindProgram(Program* program, const Vector2& screenFrame) {
     glUniform2fv(program->uniforms().screenFrame, 1, &screenFrame.x);
 }
 
-inline void bindImage(Program* program, ImageImpl* image) {
+inline void bindImage(Program* program, ImageImpl* image, uint64_t frame) {
 
+    auto handle = image->use(frame);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, image->handle());
+    glBindTexture(GL_TEXTURE_2D, handle);
     glUniform1i(program->uniforms().image, 0);
 }
 
@@ -333,17 +431,38 @@ inline void bindAttribute(GLuint location, GLenum type, bool normalized,
         glVertexAttribDivisor(location, 1);
 }
 
-inline void bindGeometry(Program* program, GeometryImpl* geometry) {
+inline void bindGeometry(Program* program, const GeometryArena::Page* page,
+    uint32_t baseVertex) {
 
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->vb());
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->ib());
+    glBindBuffer(GL_ARRAY_BUFFER, page->vb);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page->ib);
 
     const auto& attributes = program->attributes();
-    uint32_t offset = 0u, stride = sizeof(Geometry::Vertex);
+    uint32_t offset = baseVertex * sizeof(Geometry::Vertex), stride = sizeof(Geometry::Vertex);
     bindAttribute(attributes.pos, GL_FLOAT, false, 2, stride, offset);
     bindAttribute(attributes.uv, GL_FLOAT, false, 2, stride, offset);
 }
 
+inline bool visible(const Vector4& posFrame, const Vector4& bounds,
+    float width, float height) {
+
+    auto left = posFrame.x + bounds.x * posFrame.z, right = posFrame.x + bounds.z * posFrame.z;
+    auto bottom = posFrame.y + bounds.y * posFrame.w, top = posFrame.y + bounds.w * posFrame.w;
+    return std::max(left, right) >= 0.0f && std::min(left, right) <= width &&
+        std::max(bottom, top) >= 0.0f && std::min(bottom, top) <= height;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// returns milliseconds since start and restarts the measurement
+inline float elapsed(Clock::time_point& start) {
+
+    auto now = Clock::now();
+    auto ms = std::chrono::duration<float, std::milli>(now - start).count();
+    start = now;
+    return ms;
+}
+
 inline GLuint glPrimitive(Geometry::Primitive primitive) {
 
     switch (primitive) {
@@ -370,61 +489,291 @@ inline void setupScreen(const Size& screen, Color clear) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+inline bool sameState(const Key& left, const Key& right) {
+
+    return left.fillMode == right.fillMode && left.order == right.order &&
+        left.geometry == right.geometry;
+}
+
 uint32_t RendererImpl::draw(Color clear) {
 
+    TraceScope trace("Renderer::draw");
+    auto frameStart = Clock::now();
+    auto phaseStart = frameStart;
+    stats_ = FrameStats();
+
     setContext();
+    ++frame_;
+    if (!streams_.empty()) {
+        TraceScope transferTrace("Renderer::transfer");
+        for (auto* image : streams_)
+            stats_.uploadedBytes += image->transfer();
+    }
+    stats_.transferTime = elapsed(phaseStart);
+    if (pixelReader_)
+        pixelReader_->collect(false);
+
+    if (gpuTimer_)
+        gpuTimer_->beginFrame();
+    if (framebuffer_)
+        framebuffer_->bind();
     setupScreen(size_, clear);
+    if (rasterizer_)
+        rasterizer_->begin(size_, clear);
 
+    const GeometryArena::Page* lastPage = nullptr;
     GeometryImpl* lastGeometry = nullptr;
-    ImageImpl* lastImage = nullptr;
+    const Texture* lastTexture = nullptr;
     Program* lastProgram = nullptr;
     Vector2 frame(2.0f / size_.width, 2.0f / size_.height);
     auto total = 0u;
 
-    for (const auto& pair : batches_) {
-        const auto& key = pair.first;
+    auto it = batches_.begin();
+    while (it != batches_.end()) {
+        // batches which differ by image only are drawn in any order, so the ones
+        // sharing a texture are merged into a single draw call
+        const auto& key = it->first;
+        items_.clear();
+        for (; it != batches_.end() && sameState(key, it->first); ++it) {
+            auto* image = static_cast<ImageImpl*>(
+                it->first.image ? it->first.image : stubImage_.get());
+            items_.emplace_back(image, &it->second);
+        }
+        auto* geometry = static_cast<GeometryImpl*>(key.geometry);
+        if (!geometry || geometry->indexCount() == 0) {
+            stats_.batchTime += elapsed(phaseStart);
+            continue;
+        }
+        if (items_.size() > 1) {
+            std::stable_sort(std::begin(items_), std::end(items_),
+                [](const DrawItem& left, const DrawItem& right) {
+                    return left.image->texture() < right.image->texture(); });
+        }
+        stats_.batches += (uint32_t)items_.size();
+        stats_.batchTime += elapsed(phaseStart);
+
         setupFillMode(key.fillMode);
 
         auto* program = getProgram(key.fillMode);
         if (lastProgram != program) {
             bindProgram(program, frame);
             lastProgram = program;
+            lastTexture = nullptr;
+            lastPage = nullptr;
+            ++stats_.programBinds;
+        }
+        if (baseVertex_) {
+            if (lastPage != geometry->page()) {
+                bindGeometry(program, geometry->page(), 0);
+                lastPage = geometry->page();
+                stats_.bufferBinds += 2;
+            }
         }
-        auto* image = static_cast<ImageImpl*>(key.image ? key.image : stubImage_.get());
-        if (lastImage != image || lastProgram != program) {
-            bindImage(program, image);
-            lastImage = image;
+        else if (lastGeometry != geometry || lastPage == nullptr) {
+            bindGeometry(program, geometry->page(), geometry->baseVertex());
+            lastPage = geometry->page();
+            stats_.bufferBinds += 2;
         }
-        auto* geometry = static_cast<GeometryImpl*>(key.geometry);
-        if (geometry) {
-            if (lastGeometry != geometry) {
-                bindGeometry(program, geometry);
-                lastGeometry = geometry;
+        lastGeometry = geometry;
+
+        auto indices = (char*)0 + sizeof(Geometry::Index) * geometry->firstIndex();
+        for (size_t first = 0, last = 0; first < items_.size(); first = last) {
+            auto* image = items_[first].image;
+            for (last = first + 1; last < items_.size() &&
+                items_[last].image->texture() == image->texture(); ++last);
+
+            stats_.submitTime += elapsed(phaseStart);
+            auto count = bindBatch(program, geometry->bounds(), &items_[first], last - first);
+            stats_.uploadTime += elapsed(phaseStart);
+            if (count == 0)
+                continue;
+
+            if (lastTexture != image->texture()) {
+                bindImage(program, image, frame_);
+                lastTexture = image->texture();
+                ++stats_.textureBinds;
+            }
+            if (gpuTimer_)
+                gpuTimer_->beginDrawCall();
+            if (baseVertex_) {
+                glDrawElementsInstancedBaseVertex(glPrimitive(geometry->primitive()),
+                    geometry->indexCount(), GL_UNSIGNED_SHORT, indices, count,
+                    geometry->baseVertex());
             }
-            auto count = bindBatch(program, pair.second);
-            glDrawElementsInstanced(glPrimitive(geometry->primitive()),
-                geometry->indexCount(), GL_UNSIGNED_SHORT, 0, count);
+            else {
+                glDrawElementsInstanced(glPrimitive(geometry->primitive()),
+                    geometry->indexCount(), GL_UNSIGNED_SHORT, indices, count);
+            }
+            if (gpuTimer_)
+                gpuTimer_->endDrawCall();
+            if (rasterizer_) {
+                rasterizer_->draw(key.fillMode, *geometry, *image->texture(),
+                    &dataBuffer_[0], count);
+            }
+            ++stats_.drawCalls;
             total += count;
         }
+        stats_.submitTime += elapsed(phaseStart);
+    }
+    if (rasterizer_) {
+        TraceScope rasterTrace("Renderer::rasterize");
+        rasterizer_->end();
+        stats_.submitTime += elapsed(phaseStart);
     }
+    if (gpuTimer_)
+        gpuTimer_->endFrame();
+    if (framebuffer_)
+        framebuffer_->unbind();
     ASSERT(glGetError() == GL_NO_ERROR);
+
+    if (textureUsage_.budget > 0 && textureUsage_.bytes > textureUsage_.budget)
+        evictTextures(textureUsage_.bytes - textureUsage_.budget);
+    stats_.evictTime = elapsed(phaseStart);
+
+    stats_.frameTime = elapsed(frameStart);
+    if (frameTimes_.size() < FrameStats::kWindowSize)
+        frameTimes_.push_back(stats_.frameTime);
+    else
+        frameTimes_[(frame_ - 1) % FrameStats::kWindowSize] = stats_.frameTime;
     return total;
 }
 
+FrameStats RendererImpl::stats() const {
+
+    auto stats = stats_;
+    if (!frameTimes_.empty()) {
+        auto times = frameTimes_;
+        auto percentile = [&times](float value) {
+            auto nth = std::begin(times) + size_t(value * (times.size() - 1));
+            std::nth_element(std::begin(times), nth, std::end(times));
+            return *nth;
+        };
+        stats.frameTimeP50 = percentile(0.5f);
+        stats.frameTimeP99 = percentile(0.99f);
+    }
+    if (gpuTimer_) {
+        stats.gpuTime = gpuTimer_->frameTime();
+        stats.gpuDrawCallTimes = gpuTimer_->drawCallTimes();
+    }
+    return stats;
+}
+
+bool RendererImpl::gpuTiming(bool enable, bool drawCalls) {
+
+    if (!enable || !timerQuery_) {
+        gpuTimer_.reset();
+        return false;
+    }
+    if (!gpuTimer_ || gpuTimer_->drawCalls() != drawCalls)
+        gpuTimer_ = make_unique<GpuTimer>(*this, drawCalls);
+    return true;
+}
+
+Span<GLCalls> RendererImpl::glCalls() const {
+
+    return Span<GLCalls>(glCalls_.data(), (uint32_t)glCalls_.size());
+}
+
+Image::Bytes RendererImpl::pixels() const {
+
+    return rasterizer_ ? rasterizer_->pixels() : Image::Bytes(nullptr, 0);
+}
+
+bool RendererImpl::offscreen(bool enable) {
+
+    if (!enable || !framebufferObject_) {
+        framebuffer_.reset();
+        return false;
+    }
+    if (!framebuffer_) {
+        auto framebuffer = make_unique<Framebuffer>(*this);
+        if (!framebuffer->resize(size_))
+            return false;
+        framebuffer_ = std::move(framebuffer);
+    }
+    return true;
+}
+
+void RendererImpl::readPixels(PixelsCallback callback) {
+
+    TraceScope trace("Renderer::readPixels");
+    if (rasterizer_) {
+        callback(rasterizer_->pixels(), size_);
+        return;
+    }
+    setContext();
+    if (!pixelReader_)
+        pixelReader_ = make_unique<PixelReader>(*this, pixelBuffer_, sync_);
+    if (framebuffer_)
+        framebuffer_->bind();
+    pixelReader_->read(size_, std::move(callback));
+    if (framebuffer_)
+        framebuffer_->unbind();
+}
+
+void RendererImpl::finishReads() {
+
+    if (!pixelReader_)
+        return;
+    setContext();
+    pixelReader_->collect(true);
+}
+
 void RendererImpl::resize(const Size& size) {
 
-    size_.width  = std::max(1u, size.width);
-    size_.height  = std::max(1u, size.height);
+    auto width = std::max(1u, size.width), height = std::max(1u, size.height);
+    if (width == size_.width && height == size_.height)
+        return;
+    size_.width = width;
+    size_.height = height;
+    // offscreen drawing is disabled if the framebuffer can't get the new size
+    if (framebuffer_ && !framebuffer_->resize(size_))
+        framebuffer_.reset();
 }
 
-uint32_t RendererImpl::bindBatch(Program* program, const Batch& batch) {
+uint32_t RendererImpl::bindBatch(Program* program, const Vector4& bounds,
+    const DrawItem* items, size_t itemCount) {
 
+    TraceScope trace("Renderer::bindBatch");
+    size_t size = 0;
+    for (size_t i = 0; i < itemCount; ++i) {
+        const auto& batch = *items[i].batch;
+        size += batch.instances.size();
+        for (const auto* run : batch.runs)
+            size += run->instances.size();
+    }
+    if (size > dataBuffer_.size())
+        resizeDataBuffer(std::max((uint32_t)size, (uint32_t)dataBuffer_.size() * kDataGrowthFactor));
+
+    auto width = (float)size_.width, height = (float)size_.height;
     auto count = 0u;
-    for (auto& instance : batch)
-        dataBuffer_[count++] = *instance;
+    auto copy = [&](const Instance& instance) {
+        if (!visible(instance.posFrame, bounds, width, height)) {
+            ++stats_.culledInstances;
+            return;
+        }
+        dataBuffer_[count++] = instance;
+    };
+    for (size_t i = 0; i < itemCount; ++i) {
+        const auto& batch = *items[i].batch;
+        for (auto& instance : batch.instances)
+            copy(*instance);
+        for (const auto* run : batch.runs) {
+            for (auto instance : run->instances) {
+                instance.posFrame.x += run->originX;
+                instance.posFrame.y += run->originY;
+                copy(instance);
+            }
+        }
+    }
+    if (count == 0)
+        return 0;
 
     glBindBuffer(GL_ARRAY_BUFFER, glBuffer_);
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Instance) * count, &dataBuffer_[0]);
+    ++stats_.bufferBinds;
+    stats_.instances += count;
+    stats_.uploadedBytes += sizeof(Instance) * count;
 
     const auto& attributes = program->attributes();
     uint32_t offset = 0u, stride = sizeof(Instance);
@@ -438,33 +787,245 @@ uint32_t RendererImpl::bindBatch(Program* program, const Batch& batch) {
 GeometryPtr RendererImpl::makeGeometry(Geometry::Vertices vertices,
     Geometry::Indices indices, Geometry::Primitive primitive) {
 
+    TraceScope trace("Renderer::makeGeometry");
     auto ptr = MAKE_SHARED_PTR<GeometryImpl>(*this, vertices, indices, primitive);
     return ptr->init() ? ptr : GeometryPtr();
 }
 
+inline uint64_t hashGeometry(Geometry::Vertices vertices, Geometry::Indices indices,
+    Geometry::Primitive primitive) {
+
+    auto params = (uint32_t)primitive;
+    auto result = hash(&params, sizeof(params));
+    result = hash(vertices.ptr, sizeof(Geometry::Vertex) * vertices.count, result);
+    return hash(indices.ptr, sizeof(Geometry::Index) * indices.count, result);
+}
+
+GeometryPtr RendererImpl::makeSharedGeometry(Geometry::Vertices vertices,
+    Geometry::Indices indices, Geometry::Primitive primitive) {
+
+    TraceScope trace("Renderer::makeSharedGeometry");
+    if (!vertices.ptr || !indices.ptr)
+        return makeGeometry(vertices, indices, primitive);
+
+    auto hash = hashGeometry(vertices, indices, primitive);
+    auto it = sharedGeometries_.find(hash);
+    auto found = (it != sharedGeometries_.end()) ? it->second.lock() : nullptr;
+    if (found && found->equals(vertices, indices, primitive))
+        return found;
+
+    auto ptr = MAKE_SHARED_PTR<GeometryImpl>(*this, vertices, indices, primitive);
+    if (!ptr->init())
+        return GeometryPtr();
+    if (!found) {
+        ptr->share(hash, vertices, indices);
+        sharedGeometries_[hash] = ptr;
+    }
+    return ptr;
+}
+
+void RendererImpl::releaseSharedGeometry(uint64_t hash, const GeometryImpl* geometry) {
+
+    auto it = sharedGeometries_.find(hash);
+    if (it != sharedGeometries_.end()) {
+        auto found = it->second.lock();
+        if (!found || found.get() == geometry)
+            sharedGeometries_.erase(it);
+    }
+}
+
+TexturePtr RendererImpl::findSharedTexture(uint64_t hash) {
+
+    auto it = sharedTextures_.find(hash);
+    return (it != sharedTextures_.end()) ? it->second.lock() : TexturePtr();
+}
+
+void RendererImpl::registerSharedTexture(uint64_t hash, Image::Bytes bytes,
+    const TexturePtr& texture) {
+
+    texture->share(hash, bytes);
+    sharedTextures_[hash] = texture;
+}
+
+void RendererImpl::releaseSharedTexture(uint64_t hash, const Texture* texture) {
+
+    auto it = sharedTextures_.find(hash);
+    if (it != sharedTextures_.end()) {
+        auto found = it->second.lock();
+        if (!found || found.get() == texture)
+            sharedTextures_.erase(it);
+    }
+}
+
+GeometryPtr RendererImpl::makeGeometry(Geometry::Vertices vertices,
+    Geometry::Indices indices, Geometry::Primitive primitive,
+    uint32_t vertexCapacity, uint32_t indexCapacity) {
+
+    TraceScope trace("Renderer::makeGeometry");
+    auto ptr = MAKE_SHARED_PTR<GeometryImpl>(*this, vertices, indices, primitive,
+        vertexCapacity, indexCapacity);
+    return ptr->init() ? ptr : GeometryPtr();
+}
+
 ImagePtr RendererImpl::makeImage(const Size& size, Image::Format format, bool filter) {
 
-    auto ptr = MAKE_SHARED_PTR<ImageImpl>(*this, size, format, filter);
+    return makeImage(size, format, filter, false);
+}
+
+ImagePtr RendererImpl::makeImage(const Size& size, Image::Format format, bool filter,
+    bool mipmaps) {
+
+    auto ptr = MAKE_SHARED_PTR<ImageImpl>(*this, size, format, filter, mipmaps);
     return ptr->init() ? ptr : ImagePtr();
 }
 
+ImagePtr RendererImpl::makeStreamImage(const Size& size, Image::Format format, bool filter,
+    uint32_t bufferCount) {
+
+    if (bufferCount == 0) {
+        setError(InvalidArgument);
+        return ImagePtr();
+    }
+    auto ptr = MAKE_SHARED_PTR<ImageImpl>(*this, size, format, filter, false,
+        bufferCount);
+    return ptr->init() ? ptr : ImagePtr();
+}
+
+bool RendererImpl::supports(Image::Format format) const {
+
+    switch (format) {
+    case Image::Format::ETC2:
+    case Image::Format::ETC2A: return etc2_;
+    case Image::Format::BC1:
+    case Image::Format::BC3: return s3tc_;
+    case Image::Format::BC7: return bptc_;
+    default: return true;
+    }
+}
+
+void RendererImpl::registerTexture(Texture* texture) {
+
+    textures_.insert(texture);
+    textureUsage_.bytes += texture->memory();
+}
+
+void RendererImpl::unregisterTexture(Texture* texture) {
+
+    if (textures_.erase(texture) > 0 && texture->resident())
+        textureUsage_.bytes -= texture->memory();
+}
+
+void RendererImpl::restoreTexture(Texture* texture) {
+
+    if (textures_.count(texture) > 0) {
+        textureUsage_.bytes += texture->memory();
+        ++textureUsage_.restores;
+    }
+}
+
+bool RendererImpl::evictTextures(uint64_t bytes) {
+
+    TraceScope trace("Renderer::evictTextures");
+    // textures drawn in the latest frame are kept
+    std::vector<Texture*> candidates;
+    for (auto* texture : textures_) {
+        if (texture->resident() && !texture->pinned() && texture->lastUse() != frame_)
+            candidates.push_back(texture);
+    }
+    std::sort(std::begin(candidates), std::end(candidates),
+        [](const Texture* left, const Texture* right) {
+            return left->lastUse() < right->lastUse(); });
+
+    uint64_t freed = 0;
+    for (auto* texture : candidates) {
+        if (freed >= bytes)
+            break;
+        auto memory = texture->memory();
+        if (texture->evict()) {
+            freed += memory;
+            textureUsage_.bytes -= memory;
+            ++textureUsage_.evictions;
+        }
+    }
+    return freed > 0;
+}
+
+void RendererImpl::textureBudget(uint64_t bytes) {
+
+    textureUsage_.budget = bytes;
+    if (bytes > 0 && textureUsage_.bytes > bytes)
+        evictTextures(textureUsage_.bytes - bytes);
+}
+
+TextureUsage RendererImpl::textureUsage() const {
+
+    return textureUsage_;
+}
+
+WorkerPool& RendererImpl::workers() {
+
+    // started on first use so renderers that never need threads start none
+    if (!workers_)
+        workers_ = make_unique<WorkerPool>(hardwareThreads());
+    return *workers_;
+}
+
+void RendererImpl::registerStream(ImageImpl* image) {
+
+    streams_.push_back(image);
+}
+
+void RendererImpl::unregisterStream(ImageImpl* image) {
+
+    auto it = std::find(std::begin(streams_), std::end(streams_), image);
+    ASSERT(it != streams_.end() && "stream is not exist");
+    streams_.erase(it);
+}
+
 FontPtr RendererImpl::makeFont(const char* filePath, uint32_t letterSize) {
 
+    return makeFont(filePath, letterSize, false);
+}
+
+FontPtr RendererImpl::makeFont(const char* filePath, uint32_t letterSize, bool distanceField) {
+
     if (!filePath || strlen(filePath) <= 0) {
         setError(InvalidArgument);
         return FontPtr();
     }
-    auto ptr = MAKE_SHARED_PTR<FontImpl>(*this, filePath, letterSize);
+    auto ptr = MAKE_SHARED_PTR<FontImpl>(*this, filePath, letterSize, distanceField);
     return ptr->init() ? ptr : FontPtr();
 }
 
-ShapePtr RendererImpl::makeFontRect() {
+FontFacePtr RendererImpl::makeFontFace(const std::string& filePath) {
 
-    auto ptr = MAKE_SHARED_PTR<ShapeImpl>(*this, FillMode::Font);
-    ptr->geometry(rectGeometry_);
+    auto it = fontFaces_.find(filePath);
+    auto found = (it != fontFaces_.end()) ? it->second.lock() : nullptr;
+    if (found)
+        return found;
+
+    auto ptr = std::make_shared<FontFace>(*this, filePath);
+    if (!ptr->init())
+        return FontFacePtr();
+    fontFaces_[filePath] = ptr;
     return ptr;
 }
 
+void RendererImpl::releaseFontFace(const std::string& filePath, const FontFace* face) {
+
+    auto it = fontFaces_.find(filePath);
+    if (it != fontFaces_.end()) {
+        auto found = it->second.lock();
+        if (!found || found.get() == face)
+            fontFaces_.erase(it);
+    }
+}
+
+void RendererImpl::fontCache(const char* directory) {
+
+    fontCache_ = directory ? directory : "";
+}
+
 ShapePtr RendererImpl::makeRect() {
 
     auto ptr = MAKE_SHARED_PTR<ShapeImpl>(*this);
@@ -482,13 +1043,13 @@ TextPtr RendererImpl::makeText() {
     return MAKE_SHARED_PTR<TextImpl>(*this);
 }
 
-RendererPtr makeRenderer(ContextPtr context) {
+RendererPtr makeRenderer(ContextPtr context, Backend backend) {
 
-    if (!context) {
+    if (!context && backend == Backend::OpenGL) {
         setError(InvalidArgument);
         return RendererPtr();
     }
-    auto ptr = MAKE_SHARED_PTR<RendererImpl>(std::move(context));
+    auto ptr = MAKE_SHARED_PTR<RendererImpl>(std::move(context), backend);
     return ptr->init() ? ptr : RendererPtr();
 }
 
@@ -2,37 +2,89 @@
 #include <draw.h>
 #include <common.h>
 #include <opengl.h>
+#include <arena.h>
+#include <timer.h>
+#include <raster.h>
+#include <workers.h>
+#include <readback.h>
+#include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace draw {
 
 class Program;
 using ProgramPtr = std::unique_ptr<Program>;
+class GeometryImpl;
+class ImageImpl;
+class Texture;
+using TexturePtr = std::shared_ptr<Texture>;
+class FontFace;
+using FontFacePtr = std::shared_ptr<FontFace>;
 
 class RendererImpl final : public Renderer {
 
 public:
-    RendererImpl(ContextPtr context);
+    RendererImpl(ContextPtr context, Backend backend);
     virtual ~RendererImpl();
 
     RendererImpl(const RendererImpl&) = delete;
     RendererImpl& operator = (const RendererImpl&) = delete;
 
     bool init();
-    void setContext() { context_->setCurrent(); }
+    void setContext();
+    GeometryArena& arena(Geometry::Usage usage);
+    bool pixelBuffer() const { return pixelBuffer_; }
+    bool generateMipmap() const { return generateMipmap_; }
+    bool software() const { return rasterizer_ != nullptr; }
+    const std::string& fontCache() const { return fontCache_; }
 
     Instance* add(const Key& key);
     void remove(const Key& key, Instance* instance);
+    void addRun(const Key& key, const InstanceRun* run);
+    void removeRun(const Key& key, const InstanceRun* run);
+    Geometry* rectGeometry() const { return rectGeometry_.get(); }
 
-    ShapePtr makeFontRect();
+    void releaseSharedGeometry(uint64_t hash, const GeometryImpl* geometry);
+    TexturePtr findSharedTexture(uint64_t hash);
+    void registerSharedTexture(uint64_t hash, Image::Bytes bytes, const TexturePtr& texture);
+    void releaseSharedTexture(uint64_t hash, const Texture* texture);
+    FontFacePtr makeFontFace(const std::string& filePath);
+    void releaseFontFace(const std::string& filePath, const FontFace* face);
+
+    uint64_t frame() const { return frame_; }
+    void registerTexture(Texture* texture);
+    void unregisterTexture(Texture* texture);
+    void restoreTexture(Texture* texture);
+    bool evictTextures(uint64_t bytes);
+
+    // threads shared by the software rasterizer and font atlas generation
+    WorkerPool& workers();
+
+    void registerStream(ImageImpl* image);
+    void unregisterStream(ImageImpl* image);
 
     // Renderer
 
     virtual GeometryPtr makeGeometry(Geometry::Vertices vertices,
         Geometry::Indices indices, Geometry::Primitive primitive) final;
+    virtual GeometryPtr makeSharedGeometry(Geometry::Vertices vertices,
+        Geometry::Indices indices, Geometry::Primitive primitive) final;
+    virtual GeometryPtr makeGeometry(Geometry::Vertices vertices,
+        Geometry::Indices indices, Geometry::Primitive primitive,
+        uint32_t vertexCapacity, uint32_t indexCapacity) final;
     virtual ImagePtr makeImage(const Size& size, Image::Format format, bool filter) final;
+    virtual ImagePtr makeImage(const Size& size, Image::Format format, bool filter,
+        bool mipmaps) final;
+    virtual ImagePtr makeStreamImage(const Size& size, Image::Format format, bool filter,
+        uint32_t bufferCount) final;
+    virtual bool supports(Image::Format format) const final;
     virtual FontPtr makeFont(const char* filePath, uint32_t letterSize) final;
+    virtual FontPtr makeFont(const char* filePath, uint32_t letterSize,
+        bool distanceField) final;
+    virtual void fontCache(const char* directory) final;
 
     virtual ShapePtr makeRect() final;
     virtual ShapePtr makeShape() final;
@@ -40,17 +92,73 @@ public:
 
     virtual uint32_t draw(Color clear) final;
     virtual void resize(const Size& size);
+    virtual void textureBudget(uint64_t bytes) final;
+    virtual TextureUsage textureUsage() const final;
+    virtual FrameStats stats() const final;
+    virtual bool gpuTiming(bool enable, bool drawCalls) final;
+    virtual Span<GLCalls> glCalls() const final;
+    virtual Image::Bytes pixels() const final;
+    virtual bool offscreen(bool enable) final;
+    virtual void readPixels(PixelsCallback callback) final;
+    virtual void finishReads() final;
 
 private:
     ContextPtr context_;
+    const GLFunctions& gl_;
+    std::vector<GLCalls> glCalls_;
+    WorkerPoolPtr workers_;
+    RasterizerPtr rasterizer_;
+    std::unique_ptr<GeometryArena> staticArena_;
+    std::unique_ptr<GeometryArena> dynamicArena_;
+    bool baseVertex_ {false};
+    bool pixelBuffer_ {false};
+    bool generateMipmap_ {false};
+    bool etc2_ {false};
+    bool s3tc_ {false};
+    bool bptc_ {false};
+    bool timerQuery_ {false};
+    bool framebufferObject_ {false};
+    bool sync_ {false};
+    std::unordered_set<Texture*> textures_;
+    TextureUsage textureUsage_;
+    uint64_t frame_ {0};
     GeometryPtr rectGeometry_;
     ImagePtr stubImage_;
     Size size_ {1, 1};
+    std::string fontCache_;
 
     using InstancePtr = std::unique_ptr<Instance>;
-    using Batch = std::vector<InstancePtr>;
+    struct Batch {
+
+        std::vector<InstancePtr> instances;
+        std::vector<const InstanceRun*> runs;
+
+        bool empty() const { return instances.empty() && runs.empty(); }
+    };
     std::map<Key, Batch> batches_;
-    uint32_t bindBatch(Program* program, const Batch& batch);
+
+    struct DrawItem {
+
+        ImageImpl* image;
+        const Batch* batch;
+
+        DrawItem(ImageImpl* image, const Batch* batch) :
+            image(image), batch(batch) {}
+    };
+    std::vector<DrawItem> items_;
+    uint32_t bindBatch(Program* program, const Vector4& bounds,
+        const DrawItem* items, size_t itemCount);
+
+    FrameStats stats_;
+    std::vector<float> frameTimes_;
+    GpuTimerPtr gpuTimer_;
+    FramebufferPtr framebuffer_;
+    PixelReaderPtr pixelReader_;
+
+    std::unordered_map<uint64_t, std::weak_ptr<GeometryImpl>> sharedGeometries_;
+    std::unordered_map<uint64_t, std::weak_ptr<Texture>> sharedTextures_;
+    std::unordered_map<std::string, std::weak_ptr<FontFace>> fontFaces_;
+    std::vector<ImageImpl*> streams_;
 
     static const uint32_t kDataInitCapacity {1000};
     static const uint32_t kDataGrowthFactor {2};
@@ -60,6 +168,7 @@ private:
 
     ProgramPtr geometryProgram_;
     ProgramPtr fontProgram_;
+    ProgramPtr distanceFontProgram_;
     Program* getProgram(FillMode fillMode);
 };
 
@@ -3,24 +3,6 @@
 
 namespace draw {
 
-inline void uvFrame(const ImagePtr& atlas, const Rect& rect,
-    const Vector2& tile, Vector4& frame) {
-
-    if (!atlas) {
-        frame.x = 0.0f;
-        frame.y = 0.0f;
-        frame.z = 1.0f;
-        frame.w = 1.0f;
-    }
-    else {
-        auto w = atlas->size().width, h = atlas->size().height;
-        frame.x = float(rect.left) / w;
-        frame.y = float(rect.bottom) / h;
-        frame.z = float(rect.right - rect.left) / w * tile.x;
-        frame.w = float(rect.top - rect.bottom) / h * tile.y;
-    }
-}
-
 ShapeImpl::ShapeImpl(RendererImpl& renderer, FillMode fillMode) :
     renderer_(renderer),
     fillMode_(fillMode) {
@@ -6,6 +6,24 @@ namespace draw {
 
 class RendererImpl;
 
+inline void uvFrame(const ImagePtr& atlas, const Rect& rect,
+    const Vector2& tile, Vector4& frame) {
+
+    if (!atlas) {
+        frame.x = 0.0f;
+        frame.y = 0.0f;
+        frame.z = 1.0f;
+        frame.w = 1.0f;
+    }
+    else {
+        auto w = atlas->size().width, h = atlas->size().height;
+        frame.x = float(rect.left) / w;
+        frame.y = float(rect.bottom) / h;
+        frame.z = float(rect.right - rect.left) / w * tile.x;
+        frame.w = float(rect.top - rect.bottom) / h * tile.y;
+    }
+}
+
 class ShapeImpl final : public Shape {
 
 public:
@@ -62,7 +80,7 @@ private:
     FillMode fillMode_;
     GeometryPtr geometry_;
     ImagePtr image_;
-    uint32_t order_;
+    uint32_t order_ {0};
     Point position_ {0, 0};
     Size size_ {0, 0};
     Rect bounds_ {0, 0, 0, 0};
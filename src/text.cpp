@@ -1,59 +1,101 @@
 #include "text.h"
 #include <font.h>
+#include <shape.h>
 #include <renderer.h>
 #include <algorithm>
+#include <cstring>
 
 namespace draw {
 
+static const Vector2 kNoTile(1.0f, 1.0f);
+
 TextImpl::TextImpl(RendererImpl& renderer) :
     renderer_(renderer) {
 }
 
-void TextImpl::computeBounds() {
+TextImpl::~TextImpl() {
 
-    if (shapeCount_ == 0)
-        return;
+    removeRuns();
+    releaseLetters(0);
+}
+
+Key TextImpl::key(uint32_t page) const {
 
-    const auto& position = shapes_[0]->position();
-    bounds_.left = position.x;
-    bounds_.bottom = position.y;
-    bounds_.right = position.x + textSize_.width;
-    bounds_.top = position.y + textSize_.height;
+    // distance field glyphs of all sizes share a font, so they share its batches
+    auto* font = static_cast<FontImpl*>(font_.get());
+    return Key(font->distanceField() ? FillMode::DistanceFont : FillMode::Font, order_,
+        renderer_.rectGeometry(), font->page(page).get());
 }
 
-void TextImpl::buildLetter(wchar_t c, Point &pos, Size &size, uint32_t &shapeNum) {
+void TextImpl::updateRuns() {
 
-    const auto& letters = static_cast<FontImpl*>(font_.get())->letters();
-    auto it = letters.find(c);
-    if (it == letters.end())
-        return;
+    for (uint32_t page = 0; page < runs_.size(); ++page) {
+        auto& pageRun = runs_[page];
+        auto add = visibility_ && font_ && !pageRun.run.instances.empty();
+        if (add && !pageRun.added)
+            renderer_.addRun(key(page), &pageRun.run);
+        else if (!add && pageRun.added)
+            renderer_.removeRun(key(page), &pageRun.run);
+        pageRun.added = add;
+    }
+}
 
-    const auto& rect = it->second;
-    size.width = rect.right - rect.left;
-    size.height = rect.top - rect.bottom;
+void TextImpl::removeRuns() {
 
-    if (c != kSpaceSymbol) {
-        if (shapeNum >= shapeCount_)
-            shapes_[shapeNum] = renderer_.makeFontRect();
+    for (uint32_t page = 0; page < runs_.size(); ++page) {
+        auto& pageRun = runs_[page];
+        if (pageRun.added) {
+            renderer_.removeRun(key(page), &pageRun.run);
+            pageRun.added = false;
+        }
+    }
+}
 
-        auto& shape = shapes_[shapeNum];
-        shape->image(static_cast<FontImpl*>(font_.get())->atlas(), rect);
-        shape->color(color_);
-        shape->visibility(visibility_);
-        shape->order(order_);
-        shape->position(pos);
-        shape->size(size);
+void TextImpl::releaseLetters(size_t first) {
 
-        ++shapeNum;
+    auto* font = static_cast<FontImpl*>(font_.get());
+    for (auto i = first; font && i < layout_.size(); ++i) {
+        if (layout_[i].acquired)
+            font->release(text_[i]);
     }
-    pos.x += size.width;
 }
 
-inline uint32_t calcLettersCount(std::wstring& str) {
+void TextImpl::computeBounds() {
+
+    if (glyphs_.empty())
+        return;
+
+    const auto& glyph = glyphs_.front();
+    bounds_.left = position_.x + alignOffset_.x +
+        (int32_t)runs_[glyph.page].run.instances[glyph.index].posFrame.x;
+    bounds_.bottom = position_.y + alignOffset_.y;
+    bounds_.right = bounds_.left + textSize_.width;
+    bounds_.top = bounds_.bottom + textSize_.height;
+}
 
-    return (uint32_t)std::count_if(str.begin(), str.end(), [] (wchar_t c) {
-        return c != kSpaceSymbol;
-    });
+void TextImpl::buildGlyph(const Letter& letter, float x, float scale) {
+
+    auto page = letter.page;
+    if (runs_.size() <= page) {
+        runs_.resize(page + 1);
+        counts_.resize(page + 1, 0);
+    }
+    auto& instances = runs_[page].run.instances;
+    auto index = counts_[page]++;
+    glyphs_.push_back({page, index});
+
+    Instance instance;
+    instance.posFrame = Vector4(x, 0.0f, (float)(letter.rect.right - letter.rect.left) * scale,
+        (float)(letter.rect.top - letter.rect.bottom) * scale);
+    uvFrame(static_cast<FontImpl*>(font_.get())->page(page), letter.rect, kNoTile,
+        instance.uvFrame);
+    instance.color = color_;
+
+    // glyphs which stay the same are not written
+    if (index == instances.size())
+        instances.push_back(instance);
+    else if (memcmp(&instances[index], &instance, sizeof(Instance)) != 0)
+        instances[index] = instance;
 }
 
 inline int32_t computeHorizAlign(Text::HorizAlign alignment, const Size &size) {
@@ -76,84 +118,114 @@ inline int32_t computeVertAlign(Text::VertAlign alignment, const Size &size) {
     return 0;
 }
 
-void TextImpl::build() {
-
-    Point shapePos(position_);
-    Size shapeSize(0, 0);
+void TextImpl::build(size_t first) {
 
-    textSize_.width = 0;
-    textSize_.height = 0;
+    // characters before the first one keep their pen positions and glyphs
+    auto x = first < layout_.size() ? layout_[first].x : advance_;
+    auto glyph = first < layout_.size() ? layout_[first].glyph : (uint32_t)glyphs_.size();
 
-    auto lettersCount = calcLettersCount(text_);
-    if (lettersCount > shapeCount_)
-        shapes_.resize(lettersCount);
-
-    auto i = 0u;
-    for (auto& c : text_)
-        buildLetter(c, shapePos, shapeSize, i);
+    // glyphs of the next characters are written over the old ones page by page
+    counts_.resize(runs_.size());
+    for (size_t page = 0; page < runs_.size(); ++page)
+        counts_[page] = (uint32_t)runs_[page].run.instances.size();
+    for (auto i = glyph; i < glyphs_.size(); ++i) {
+        auto& count = counts_[glyphs_[i].page];
+        count = std::min(count, glyphs_[i].index);
+    }
+    glyphs_.resize(glyph);
+    layout_.resize(text_.size());
+
+    auto* font = static_cast<FontImpl*>(font_.get());
+    auto scale = font && letterSize_ ? (float)letterSize_ / font->letterSize() : 1.0f;
+    auto height = textSize_.height;
+    for (auto i = first; font && i < text_.size(); ++i) {
+        auto& layout = layout_[i];
+        layout.x = x;
+        layout.glyph = (uint32_t)glyphs_.size();
+        auto c = text_[i];
+        auto* letter = font->acquire(c);
+        layout.acquired = letter != nullptr;
+        if (!letter)
+            continue;
+        if (c != kSpaceSymbol)
+            buildGlyph(*letter, x, scale);
+        x += (float)(letter->rect.right - letter->rect.left) * scale;
+        height = (uint32_t)((float)(letter->rect.top - letter->rect.bottom) * scale + 0.5f);
+    }
+    for (size_t page = 0; page < runs_.size(); ++page)
+        runs_[page].run.instances.resize(counts_[page]);
 
-    textSize_.width = shapePos.x - position_.x;
-    textSize_.height = shapeSize.height;
+    advance_ = x;
+    textSize_.width = (uint32_t)(x + 0.5f);
+    textSize_.height = text_.empty() ? 0 : height;
 
-    shapeCount_ = lettersCount;
-    for (i = shapeCount_; i < shapes_.size(); ++i)
-        shapes_[i]->visibility(false);
+    updateRuns();
+    align();
+}
 
-    alignOffset_.x = computeHorizAlign(horizAlign_, textSize_);
-    alignOffset_.y = computeVertAlign(vertAlign_, textSize_);
+void TextImpl::moveRun() {
 
-    for (i = 0; i < shapeCount_; ++i) {
-        auto& shape = shapes_[i];
-        const auto& pos = shape->position();
-        shape->position(Point(pos.x + alignOffset_.x, pos.y + alignOffset_.y));
+    for (auto& pageRun : runs_) {
+        pageRun.run.originX = (float)(position_.x + alignOffset_.x);
+        pageRun.run.originY = (float)(position_.y + alignOffset_.y);
     }
-    computeBounds();
 }
 
 void TextImpl::align() {
 
-    auto last = alignOffset_;
-
     alignOffset_.x = computeHorizAlign(horizAlign_, textSize_);
     alignOffset_.y = computeVertAlign(vertAlign_, textSize_);
-
-    if (alignOffset_.x != last.x || alignOffset_.y != last.y) {
-
-        for (size_t i = 0; i < shapeCount_; ++i) {
-            auto& shape = shapes_[i];
-            const auto& pos = shape->position();
-            shape->position(Point(pos.x - last.x + alignOffset_.x, 
-                pos.y - last.y + alignOffset_.y));
-        }
-        computeBounds();
-    }
+    moveRun();
+    computeBounds();
 }
 
 void TextImpl::font(const FontPtr& font) {
 
     if (font_ != font) {
+        removeRuns();
+        releaseLetters(0);
         font_ = font;
-        if (!text_.empty())
-            build();
+        runs_.clear();
+        layout_.clear();
+        glyphs_.clear();
+        advance_ = 0.0f;
+        textSize_ = Size(0, 0);
+        build(0);
     }
 }
 
 void TextImpl::text(const wchar_t* text) {
 
-    if (text_ != text) {
-        if (text && wcslen(text) > 0)
-            text_ = text;
-        else
-            text_.clear();
-        build();
-    }
+    if (!text)
+        text = L"";
+    // only characters from the first difference on are laid out again
+    auto length = wcslen(text);
+    auto common = std::min(length, text_.size());
+    auto first = (size_t)(std::mismatch(text, text + common, text_.begin()).first - text);
+    if (first == common && length == text_.size())
+        return;
+
+    releaseLetters(first);
+    text_.assign(text, length);
+    build(first);
 }
 
 void TextImpl::color(Color color) {
 
     color_ = color;
-    for (size_t i = 0; i < shapeCount_; ++i)
-        shapes_[i]->color(color_);
+    for (auto& pageRun : runs_) {
+        for (auto& instance : pageRun.run.instances)
+            instance.color = color_;
+    }
+}
+
+void TextImpl::letterSize(uint32_t size) {
+
+    if (letterSize_ != size) {
+        letterSize_ = size;
+        releaseLetters(0);
+        build(0);
+    }
 }
 
 void TextImpl::horizAlign(Text::HorizAlign alignment) {
@@ -176,30 +248,23 @@ void TextImpl::visibility(bool enable) {
 
     if (visibility_ != enable) {
         visibility_ = enable;
-        for (size_t i = 0; i < shapeCount_; ++i)
-            shapes_[i]->visibility(visibility_);
+        updateRuns();
     }
 }
 
 void TextImpl::order(uint32_t order) {
 
     if (order_ != order) {
+        removeRuns();
         order_ = order;
-        for (size_t i = 0; i < shapeCount_; ++i)
-            shapes_[i]->order(order_);
+        updateRuns();
     }
 }
 
 void TextImpl::position(const Point& position) {
 
-    Point dPos(position.x - position_.x, position.y - position_.y);
     position_ = position;
-
-    for (size_t i = 0; i < shapeCount_; ++i) {
-        auto& shape = shapes_[i];
-        const auto&pos = shape->position();
-        shape->position(Point(pos.x + dPos.x, pos.y + dPos.y));
-    }
+    moveRun();
     computeBounds();
 }
 
@@ -1,18 +1,20 @@
 #pragma once
 #include <draw.h>
 #include <common.h>
+#include <deque>
 #include <string>
 #include <vector>
 
 namespace draw {
 
 class RendererImpl;
+struct Letter;
 
 class TextImpl final : public Text {
 
 public:
     TextImpl(RendererImpl& renderer);
-    virtual ~TextImpl() = default;
+    virtual ~TextImpl();
 
     TextImpl(const TextImpl&) = delete;
     TextImpl& operator = (const TextImpl&) = delete;
@@ -28,6 +30,9 @@ public:
     virtual void color(Color color) final;
     virtual Color color() const final { return color_; }
 
+    virtual void letterSize(uint32_t size) final;
+    virtual uint32_t letterSize() const final { return letterSize_; }
+
     virtual void horizAlign(HorizAlign alignment) final;
     virtual HorizAlign horizAlign() const final { return horizAlign_; }
 
@@ -49,19 +54,53 @@ public:
 
 private:
     void computeBounds();
-    void buildLetter(wchar_t c, Point &pos, Size &size, uint32_t &shapeNum);
+    void buildGlyph(const Letter& letter, float x, float scale);
+    // gives the glyphs of characters from the first one back to the font
+    void releaseLetters(size_t first);
 
-    void build();
+    // lays out characters from the first one, the previous ones keep their glyphs
+    void build(size_t first);
     void align();
+    // glyphs are relative to the run origin, so moves don't touch them
+    void moveRun();
+
+    Key key(uint32_t page) const;
+    void updateRuns();
+    void removeRuns();
 
     RendererImpl& renderer_;
     FontPtr font_;
     uint32_t order_ {0};
     std::wstring text_;
-    std::vector<ShapePtr> shapes_;
-    size_t shapeCount_ {0};
+
+    struct PageRun {
+
+        InstanceRun run;
+        bool added {false};
+    };
+    // glyphs of the text on each font page, drawn as a single unit of its batch,
+    // a deque keeps the runs in place while pages are added
+    std::deque<PageRun> runs_;
+
+    struct Layout {
+
+        float x {0.0f}; // pen position before the character
+        uint32_t glyph {0}; // index of its glyph or of the next one (spaces have no glyphs)
+        bool acquired {false}; // the font has a glyph of the character
+    };
+    std::vector<Layout> layout_;
+
+    struct Glyph {
+
+        uint32_t page;
+        uint32_t index; // in the run of the page
+    };
+    std::vector<Glyph> glyphs_;
+    std::vector<uint32_t> counts_; // glyphs written to each run while building
     Point position_ {0, 0};
     Point alignOffset_ {0, 0};
+    uint32_t letterSize_ {0};
+    float advance_ {0.0f}; // pen position after the last character
     Size textSize_ {0, 0};
     Rect bounds_ {0, 0, 0, 0};
     Color color_ {0xFFFFFFFF};
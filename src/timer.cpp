@@ -0,0 +1,105 @@
+#include "timer.h"
+#include <renderer.h>
+#include <error.h>
+
+namespace draw {
+
+static const float kNanosecondsPerMs = 1000000.0f;
+
+GpuTimer::GpuTimer(RendererImpl& renderer, bool drawCalls) :
+    renderer_(renderer),
+    drawCalls_(drawCalls) {
+}
+
+GpuTimer::~GpuTimer() {
+
+    renderer_.setContext();
+
+    for (auto& frame : frames_) {
+        if (frame.query != 0)
+            glDeleteQueries(1, &frame.query);
+        if (!frame.drawCallQueries.empty()) {
+            glDeleteQueries((GLsizei)frame.drawCallQueries.size(),
+                frame.drawCallQueries.data());
+        }
+    }
+}
+
+void GpuTimer::beginFrame() {
+
+    current_ = (current_ + 1) % kLatency;
+    auto& frame = frames_[current_];
+    if (frame.pending)
+        collect(frame);
+
+    frame.drawCallCount = 0;
+    if (frame.query == 0)
+        glGenQueries(1, &frame.query);
+    glBeginQuery(GL_TIME_ELAPSED, frame.query);
+}
+
+void GpuTimer::endFrame() {
+
+    glEndQuery(GL_TIME_ELAPSED);
+    frames_[current_].pending = true;
+}
+
+void GpuTimer::beginDrawCall() {
+
+    if (!drawCalls_)
+        return;
+
+    // elapsed time queries can't be nested in the frame one, so draw calls are
+    // measured by pairs of timestamps
+    auto& frame = frames_[current_];
+    if (frame.drawCallCount * 2 == frame.drawCallQueries.size()) {
+        GLuint queries[2] = {0, 0};
+        glGenQueries(2, queries);
+        frame.drawCallQueries.insert(frame.drawCallQueries.end(), queries, queries + 2);
+    }
+    glQueryCounter(frame.drawCallQueries[frame.drawCallCount * 2], GL_TIMESTAMP);
+}
+
+void GpuTimer::endDrawCall() {
+
+    if (!drawCalls_)
+        return;
+
+    auto& frame = frames_[current_];
+    glQueryCounter(frame.drawCallQueries[frame.drawCallCount * 2 + 1], GL_TIMESTAMP);
+    ++frame.drawCallCount;
+}
+
+Span<float> GpuTimer::drawCallTimes() const {
+
+    return Span<float>(drawCallTimes_.data(), (uint32_t)drawCallTimes_.size());
+}
+
+void GpuTimer::collect(Frame& frame) {
+
+    frame.pending = false;
+
+    // queries complete in order and the frame one ends after all draw calls,
+    // so it tells about all of them; results which are still not ready are
+    // dropped instead of waiting
+    GLint available = 0;
+    glGetQueryObjectiv(frame.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == 0)
+        return;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &elapsed);
+    frameTime_ = elapsed / kNanosecondsPerMs;
+    if (!drawCalls_)
+        return;
+
+    drawCallTimes_.resize(frame.drawCallCount);
+    for (uint32_t i = 0; i < frame.drawCallCount; ++i) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(frame.drawCallQueries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.drawCallQueries[i * 2 + 1], GL_QUERY_RESULT, &end);
+        drawCallTimes_[i] = end > begin ? (end - begin) / kNanosecondsPerMs : 0.0f;
+    }
+}
+
+} // namespace draw
@@ -0,0 +1,53 @@
+#pragma once
+#include <draw.h>
+#include <opengl.h>
+#include <vector>
+
+namespace draw {
+
+class RendererImpl;
+
+class GpuTimer final {
+
+public:
+    GpuTimer(RendererImpl& renderer, bool drawCalls);
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator = (const GpuTimer&) = delete;
+
+    bool drawCalls() const { return drawCalls_; }
+
+    void beginFrame();
+    void endFrame();
+    void beginDrawCall();
+    void endDrawCall();
+
+    float frameTime() const { return frameTime_; }
+    Span<float> drawCallTimes() const;
+
+private:
+    // results are read with this count of frames latency, so the pipeline is not stalled
+    static const uint32_t kLatency = 3;
+
+    struct Frame {
+
+        GLuint query {0}; // elapsed time of the whole frame
+        std::vector<GLuint> drawCallQueries; // begin and end timestamps of draw calls
+        uint32_t drawCallCount {0};
+        bool pending {false};
+    };
+
+    void collect(Frame& frame);
+
+    RendererImpl& renderer_;
+    bool drawCalls_ {false};
+    Frame frames_[kLatency];
+    uint32_t current_ {0};
+    float frameTime_ {0.0f};
+    std::vector<float> drawCallTimes_;
+};
+
+using GpuTimerPtr = std::unique_ptr<GpuTimer>;
+
+} // namespace draw
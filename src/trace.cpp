@@ -0,0 +1,102 @@
+#include "trace.h"
+#include <error.h>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace draw {
+
+std::atomic<bool> gTracing {false};
+static std::mutex gTraceMutex;
+static TraceSinkPtr gTraceSink;
+
+void setTraceSink(TraceSinkPtr sink) {
+
+    std::lock_guard<std::mutex> guard(gTraceMutex);
+    gTraceSink = std::move(sink);
+    gTracing.store(gTraceSink != nullptr, std::memory_order_relaxed);
+}
+
+TraceSinkPtr getTraceSink() {
+
+    std::lock_guard<std::mutex> guard(gTraceMutex);
+    return gTraceSink;
+}
+
+uint64_t getTraceTime() {
+
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// writes events in Chrome trace event format (chrome://tracing, Perfetto)
+class ChromeTraceSink final : public TraceSink {
+
+public:
+    ChromeTraceSink(const char* filePath) :
+        filePath_(filePath) {
+    }
+    virtual ~ChromeTraceSink() {
+
+        if (file_) {
+            fputs("\n]}\n", file_);
+            fclose(file_);
+        }
+    }
+
+    ChromeTraceSink(const ChromeTraceSink&) = delete;
+    ChromeTraceSink& operator = (const ChromeTraceSink&) = delete;
+
+    bool init() {
+
+        file_ = fopen(filePath_, "w");
+        if (!file_) {
+            setError(InvalidArgument);
+            return false;
+        }
+        fputs("{\"traceEvents\":[", file_);
+        return true;
+    }
+
+    // TraceSink
+
+    virtual void begin(const char* name, uint64_t timestamp) final {
+
+        write(name, 'B', timestamp);
+    }
+    virtual void end(const char* name, uint64_t timestamp) final {
+
+        write(name, 'E', timestamp);
+    }
+
+private:
+    void write(const char* name, char phase, uint64_t timestamp) {
+
+        auto thread = std::hash<std::thread::id>()(std::this_thread::get_id()) & 0xFFFFFFFF;
+
+        std::lock_guard<std::mutex> guard(mutex_);
+        fprintf(file_, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%llu}",
+            first_ ? "" : ",", name, phase, (unsigned long long)timestamp,
+            (unsigned long long)thread);
+        first_ = false;
+    }
+
+    const char* filePath_ {nullptr};
+    FILE* file_ {nullptr};
+    bool first_ {true};
+    std::mutex mutex_;
+};
+
+TraceSinkPtr makeChromeTraceSink(const char* filePath) {
+
+    if (!filePath || filePath[0] == '\0') {
+        setError(InvalidArgument);
+        return TraceSinkPtr();
+    }
+    auto ptr = MAKE_SHARED_PTR<ChromeTraceSink>(filePath);
+    return ptr->init() ? ptr : TraceSinkPtr();
+}
+
+} // namespace draw
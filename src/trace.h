@@ -0,0 +1,39 @@
+#pragma once
+#include <draw.h>
+#include <atomic>
+
+namespace draw {
+
+extern std::atomic<bool> gTracing;
+
+TraceSinkPtr getTraceSink();
+uint64_t getTraceTime();
+
+// emits begin/end events of a scope, costs one relaxed load if no sink is installed
+class TraceScope final {
+
+public:
+    explicit TraceScope(const char* name) :
+        name_(name) {
+
+        if (gTracing.load(std::memory_order_relaxed)) {
+            sink_ = getTraceSink();
+            if (sink_)
+                sink_->begin(name_, getTraceTime());
+        }
+    }
+    ~TraceScope() {
+
+        if (sink_)
+            sink_->end(name_, getTraceTime());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator = (const TraceScope&) = delete;
+
+private:
+    const char* name_ {nullptr};
+    TraceSinkPtr sink_;
+};
+
+} // namespace draw
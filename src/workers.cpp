@@ -0,0 +1,68 @@
+#include "workers.h"
+
+namespace draw {
+
+WorkerPool::WorkerPool(uint32_t threadCount) {
+
+    for (uint32_t i = 1; i < threadCount; ++i)
+        workers_.emplace_back(&WorkerPool::work, this, i);
+}
+
+WorkerPool::~WorkerPool() {
+
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+    }
+    started_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void WorkerPool::run(uint32_t count, const Job& job) {
+
+    if (count <= 1 || workers_.empty()) {
+        job(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        job_ = &job;
+        count_ = count;
+        finishedCount_ = 0;
+        ++generation_;
+    }
+    started_.notify_all();
+    job(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this]() { return finishedCount_ == workers_.size(); });
+    job_ = nullptr;
+}
+
+void WorkerPool::work(uint32_t thread) {
+
+    uint64_t generation = 0;
+    for (;;) {
+        const Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            started_.wait(lock, [this, generation]() {
+                return stop_ || generation_ != generation; });
+            if (stop_)
+                return;
+            generation = generation_;
+            // threads beyond the count of the run have nothing to do
+            job = thread < count_ ? job_ : nullptr;
+        }
+        if (job)
+            (*job)(thread);
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            ++finishedCount_;
+        }
+        finished_.notify_one();
+    }
+}
+
+} // namespace draw
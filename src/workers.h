@@ -0,0 +1,51 @@
+#pragma once
+#include <draw.h>
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace draw {
+
+inline uint32_t hardwareThreads() {
+
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// threads kept for the renderer lifetime, so jobs never start threads, the thread
+// calling run works as thread 0
+class WorkerPool final {
+
+public:
+    using Job = std::function<void(uint32_t thread)>;
+
+    explicit WorkerPool(uint32_t threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator = (const WorkerPool&) = delete;
+
+    uint32_t threadCount() const { return (uint32_t)workers_.size() + 1; }
+    // runs the job on threads 0 to count - 1 and returns when all of them are done
+    void run(uint32_t count, const Job& job);
+
+private:
+    void work(uint32_t thread);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable started_;
+    std::condition_variable finished_;
+    const Job* job_ {nullptr};
+    uint32_t count_ {0};
+    uint64_t generation_ {0};
+    uint32_t finishedCount_ {0};
+    bool stop_ {false};
+};
+
+using WorkerPoolPtr = std::unique_ptr<WorkerPool>;
+
+} // namespace draw
@@ -3,6 +3,10 @@
 #include <draw.h>
 #include <gmock/gmock.h>
 #include <bandit/bandit.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #define Given(obj, action) ON_CALL(obj, action)
 #define Verify(obj, action) EXPECT_CALL(obj, action)
@@ -37,6 +41,37 @@ inline void mockGL() {
     Given(::glMocked(), gl_GetUniformLocation(_, _)).WillByDefault(Return(1));
 }
 
+// records names of begun scopes, ends are recorded as "end"
+class RecordingSink final : public draw::TraceSink {
+
+public:
+    // font atlases trace from worker threads too
+    virtual void begin(const char* name, uint64_t) final {
+        std::lock_guard<std::mutex> guard(mutex_);
+        events.push_back(name);
+    }
+    virtual void end(const char*, uint64_t) final {
+        std::lock_guard<std::mutex> guard(mutex_);
+        events.push_back("end");
+    }
+    uint32_t count(const char* name) const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return (uint32_t)std::count(events.begin(), events.end(), name);
+    }
+    std::vector<std::string> events;
+
+private:
+    mutable std::mutex mutex_;
+};
+
+// draws a frame of a software renderer and returns its RGBA pixels
+inline std::vector<uint8_t> drawPixels(const RendererPtr& renderer, Color clear = 0x000000FF) {
+
+    renderer->draw(clear);
+    auto pixels = renderer->pixels();
+    return std::vector<uint8_t>(pixels.ptr, pixels.ptr + pixels.count);
+}
+
 static const auto kImageWidth = 2u, kImageHeight = 2u;
 static const Size kImageSize {kImageWidth, kImageHeight};
 static const auto kImageFormat = Image::Format::A;
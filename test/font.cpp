@@ -1,4 +1,9 @@
 #include "common.h"
+#include <file.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
 
 using namespace details;
 
@@ -29,6 +34,182 @@ go_bandit([] {
             AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
         });
 
+        it("should pack glyphs of large letter sizes into a square atlas", [&] {
+
+            Verify(::glMocked(), gl_TexImage2D(GL_TEXTURE_2D, 0, _, 1024, 1024, 0, _, _, _))
+                .Times(1);
+
+            auto ptr = renderer->makeFont(kFontFilePath, 100);
+
+            AssertThat(ptr, Is().Not().EqualTo(FontPtr()));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("should load a font file once for all letter sizes", [&] {
+
+            auto sink = std::make_shared<RecordingSink>();
+            draw::setTraceSink(sink);
+            std::vector<FontPtr> fonts;
+            for (auto letterSize : {12u, 16u, 24u})
+                fonts.push_back(renderer->makeFont(kFontFilePath, letterSize));
+            auto loads = sink->count("Font::loadFace");
+            fonts.clear();
+            renderer->makeFont(kFontFilePath, kFontLetterSize);
+            draw::setTraceSink(nullptr);
+
+            AssertThat(loads, Is().EqualTo(1u));
+            AssertThat(sink->count("Font::loadFace"), Is().EqualTo(2u));
+        });
+
+        it("should parse a font file once per thread for all letter sizes", [&] {
+
+            auto sink = std::make_shared<RecordingSink>();
+            draw::setTraceSink(sink);
+            // the largest font first, so it takes the most threads
+            auto font1 = renderer->makeFont(kFontFilePath, 32, true);
+            auto parses = sink->count("Font::parseFace");
+            auto font2 = renderer->makeFont(kFontFilePath, 64);
+            auto font3 = renderer->makeFont(kFontFilePath, 24, true);
+            draw::setTraceSink(nullptr);
+
+            AssertThat(parses, Is().GreaterThan(0u));
+            AssertThat(sink->count("Font::parseFace"), Is().EqualTo(parses));
+        });
+
+        it("should rasterize glyphs of fonts sharing a file in their own sizes", [&] {
+
+            auto render = [&](bool shared) {
+                auto software = makeRenderer(nullptr, Backend::Software);
+                software->resize({100, 40});
+                auto smallText = software->makeText();
+                if (shared)
+                    smallText->font(software->makeFont(kFontFilePath, kFontLetterSize));
+                auto large = software->makeFont(kFontFilePath, 24);
+                smallText->text(L"\u0434");
+                auto text = software->makeText();
+                text->font(large);
+                text->text(L"Ab\u0434\u0436");
+                text->visibility(true);
+                return drawPixels(software);
+            };
+            AssertThat(render(true), Is().EqualTo(render(false)));
+        });
+
+        describe("with a cache directory", [&] {
+
+            std::unique_ptr<TempDirectory> cache;
+            std::shared_ptr<RecordingSink> sink;
+            auto generations = [&sink] { return sink->count("Font::generateAtlas"); };
+
+            before_each([&] {
+
+                cache = std::unique_ptr<TempDirectory>(new TempDirectory());
+                sink = std::make_shared<RecordingSink>();
+                draw::setTraceSink(sink);
+            });
+
+            after_each([&] {
+
+                draw::setTraceSink(nullptr);
+                cache.reset();
+            });
+
+            it("should map an atlas cached by an earlier font instead of rasterizing it", [&] {
+
+                renderer->fontCache(cache->path().c_str());
+                AssertThat(renderer->makeFont(kFontFilePath, kFontLetterSize),
+                    Is().Not().EqualTo(FontPtr()));
+                AssertThat(generations(), Is().EqualTo(1u));
+                AssertThat(cache->files().size(), Is().EqualTo(1u));
+
+                auto render = [&](const char* cacheDirectory) {
+                    auto software = makeRenderer(nullptr, Backend::Software);
+                    software->resize({100, 20});
+                    software->fontCache(cacheDirectory);
+                    auto text = software->makeText();
+                    text->font(software->makeFont(kFontFilePath, kFontLetterSize));
+                    text->text(L"Cached \u0434");
+                    text->visibility(true);
+                    return drawPixels(software);
+                };
+                auto cached = render(cache->path().c_str());
+                AssertThat(generations(), Is().EqualTo(1u));
+                AssertThat(cached, Is().EqualTo(render(nullptr)));
+            });
+
+            it("should rewrite cache files which don't match the font", [&] {
+
+                renderer->fontCache(cache->path().c_str());
+                renderer->makeFont(kFontFilePath, kFontLetterSize);
+                AssertThat(cache->files().size(), Is().EqualTo(1u));
+                std::ofstream(cache->path() + "/" + cache->files()[0]) << "not an atlas";
+
+                AssertThat(renderer->makeFont(kFontFilePath, kFontLetterSize),
+                    Is().Not().EqualTo(FontPtr()));
+                AssertThat(renderer->makeFont(kFontFilePath, kFontLetterSize),
+                    Is().Not().EqualTo(FontPtr()));
+                AssertThat(generations(), Is().EqualTo(2u));
+            });
+
+            it("should keep atlases of equally named fonts of other directories apart", [&] {
+
+                // a copy with a different content under the same name
+                TempDirectory fonts;
+                auto otherFilePath = fonts.path() + "/" + kFontFilePath;
+                {
+                    std::ofstream other(otherFilePath, std::ios::binary);
+                    other << std::ifstream(kFontFilePath, std::ios::binary).rdbuf() << '\0';
+                }
+                renderer->fontCache(cache->path().c_str());
+                for (auto i = 0; i < 2; ++i) {
+                    AssertThat(renderer->makeFont(kFontFilePath, kFontLetterSize),
+                        Is().Not().EqualTo(FontPtr()));
+                    AssertThat(renderer->makeFont(otherFilePath.c_str(), kFontLetterSize),
+                        Is().Not().EqualTo(FontPtr()));
+                }
+                AssertThat(generations(), Is().EqualTo(2u));
+                AssertThat(cache->files().size(), Is().EqualTo(2u));
+            });
+
+            it("should cache distance field atlases apart from bitmap ones", [&] {
+
+                renderer->fontCache(cache->path().c_str());
+                for (auto distanceField : {true, false, true, false}) {
+                    auto font = renderer->makeFont(kFontFilePath, kFontLetterSize, distanceField);
+                    AssertThat(font->distanceField(), Is().EqualTo(distanceField));
+                }
+                AssertThat(generations(), Is().EqualTo(2u));
+                AssertThat(cache->files().size(), Is().EqualTo(2u));
+            });
+
+            it("should hash a font file once for all letter sizes", [&] {
+
+                renderer->fontCache(cache->path().c_str());
+                auto font1 = renderer->makeFont(kFontFilePath, kFontLetterSize);
+                auto font2 = renderer->makeFont(kFontFilePath, kFontLetterSize * 2);
+                auto font3 = renderer->makeFont(kFontFilePath, kFontLetterSize, true);
+                AssertThat(sink->count("Font::hashFace"), Is().EqualTo(1u));
+            });
+
+            it("should make fonts if the directory can't be written", [&] {
+
+                renderer->fontCache("missing/directory");
+                AssertThat(renderer->makeFont(kFontFilePath, kFontLetterSize),
+                    Is().Not().EqualTo(FontPtr()));
+                AssertThat(renderer->makeFont(kFontFilePath, kFontLetterSize),
+                    Is().Not().EqualTo(FontPtr()));
+                AssertThat(generations(), Is().EqualTo(2u));
+            });
+
+            it("should throw InvalidFontFile if font file is not exist", [&] {
+
+                renderer->fontCache(cache->path().c_str());
+                AssertThat(renderer->makeFont("none.ttf", kFontLetterSize), Is().EqualTo(FontPtr()));
+                AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidFontFile));
+            });
+        });
+
         it("should throw InvalidArgument if filePath is invalid", [&] {
 
             auto ptr = renderer->makeFont(nullptr, kFontLetterSize);
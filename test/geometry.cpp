@@ -71,6 +71,15 @@ go_bandit([] {
             AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
         });
 
+        it("should throw InvalidArgument if an index is out of vertices", [&] {
+
+            const Geometry::Index indices[] = {0, 1, kVertexCount};
+            auto ptr = renderer->makeGeometry({kVertices, kVertexCount}, {indices, 3}, kPrimitive);
+
+            AssertThat(ptr, Is().EqualTo(GeometryPtr()));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
         it("throw OpenGLOutOfMemory if is not enough memory to create OpenGL resources", [&] {
 
             Given(::glMocked(), gl_GetError()).WillByDefault(Return(GL_OUT_OF_MEMORY));
@@ -81,5 +90,159 @@ go_bandit([] {
             AssertThat(ptr, Is().EqualTo(GeometryPtr()));
             AssertThat(getLastError(), Is().EqualTo(ErrorCode::OpenGLOutOfMemory));
         });
+
+        it("should be suballocated from a shared arena buffer", [&] {
+
+            Verify(::glMocked(), gl_GenBuffers(_, _)).Times(0);
+            Verify(::glMocked(), gl_BufferData(_, _, _, _)).Times(0);
+
+            auto ptr = renderer->makeGeometry(
+                {kVertices, kVertexCount}, {kIndices, kIndexCount}, kPrimitive);
+
+            AssertThat(ptr, Is().Not().EqualTo(GeometryPtr()));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("should be drawn with base vertex and first index", [&] {
+
+            auto geometry = renderer->makeGeometry(
+                {kVertices, kVertexCount}, {kIndices, kIndexCount}, kPrimitive);
+            auto shape = renderer->makeShape();
+            shape->geometry(geometry);
+            shape->visibility(true);
+
+            Verify(::glMocked(), gl_BindBuffer(_, _)).Times(::testing::AnyNumber());
+            Verify(::glMocked(), gl_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _)).Times(1);
+            Verify(::glMocked(), gl_DrawElementsInstancedBaseVertex(_, _, _, _, _, 0)).Times(1);
+            Verify(::glMocked(), gl_DrawElementsInstancedBaseVertex(
+                GL_TRIANGLES, kIndexCount, GL_UNSIGNED_SHORT,
+                (char*)0 + sizeof(Geometry::Index) * 6, 1, 4)).Times(1);
+
+            auto rect = renderer->makeRect();
+            rect->visibility(true);
+            AssertThat(renderer->draw(0), Is().EqualTo(2));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("should share geometries of identical content", [&] {
+
+            auto ptr1 = renderer->makeSharedGeometry(
+                {kVertices, kVertexCount}, {kIndices, kIndexCount}, kPrimitive);
+            auto ptr2 = renderer->makeSharedGeometry(
+                {kVertices, kVertexCount}, {kIndices, kIndexCount}, kPrimitive);
+            auto ptr3 = renderer->makeSharedGeometry(
+                {kVertices, kVertexCount}, {kIndices, 3}, kPrimitive);
+
+            AssertThat(ptr1, Is().Not().EqualTo(GeometryPtr()));
+            AssertThat(ptr2, Is().EqualTo(ptr1));
+            AssertThat(ptr3, Is().Not().EqualTo(ptr1));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+        });
+
+        it("should be created as static by default", [&] {
+
+            auto ptr = renderer->makeGeometry(
+                {kVertices, kVertexCount}, {kIndices, kIndexCount}, kPrimitive);
+
+            AssertThat(ptr->usage(), Is().EqualTo(Geometry::Usage::Static));
+            AssertThat(ptr->vertexCapacity(), Is().EqualTo(kVertexCount));
+            AssertThat(ptr->indexCapacity(), Is().EqualTo(kIndexCount));
+        });
+
+        it("should be created as dynamic with reserved capacity", [&] {
+
+            auto ptr = renderer->makeGeometry({nullptr, 0}, {nullptr, 0}, kPrimitive,
+                kVertexCount * 2, kIndexCount * 2);
+
+            AssertThat(ptr, Is().Not().EqualTo(GeometryPtr()));
+            AssertThat(ptr->usage(), Is().EqualTo(Geometry::Usage::Dynamic));
+            AssertThat(ptr->vertexCount(), Is().EqualTo(0));
+            AssertThat(ptr->indexCount(), Is().EqualTo(0));
+            AssertThat(ptr->vertexCapacity(), Is().EqualTo(kVertexCount * 2));
+            AssertThat(ptr->indexCapacity(), Is().EqualTo(kIndexCount * 2));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+        });
+
+        it("should throw InvalidArgument if capacity is less than count", [&] {
+
+            auto ptr = renderer->makeGeometry({kVertices, kVertexCount},
+                {kIndices, kIndexCount}, kPrimitive, kVertexCount - 1, kIndexCount);
+
+            AssertThat(ptr, Is().EqualTo(GeometryPtr()));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("update: should update ranges without reallocation", [&] {
+
+            auto ptr = renderer->makeGeometry({kVertices, kVertexCount},
+                {kIndices, kIndexCount}, kPrimitive, kVertexCount * 2, kIndexCount * 2);
+
+            Verify(::glMocked(), gl_BufferData(_, _, _, _)).Times(0);
+            Verify(::glMocked(), gl_BufferSubData(_, _, _, _)).Times(2);
+
+            ptr->update(kVertexCount, {kVertices, kVertexCount},
+                kIndexCount, {kIndices, kIndexCount});
+
+            AssertThat(ptr->vertexCount(), Is().EqualTo(kVertexCount * 2));
+            AssertThat(ptr->indexCount(), Is().EqualTo(kIndexCount * 2));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("update: should throw InvalidArgument if geometry is static", [&] {
+
+            auto ptr = renderer->makeGeometry(
+                {kVertices, kVertexCount}, {kIndices, kIndexCount}, kPrimitive);
+            ptr->update(0, {kVertices, kVertexCount}, 0, {kIndices, kIndexCount});
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("update: should throw InvalidArgument if a range exceeds capacity", [&] {
+
+            auto ptr = renderer->makeGeometry({kVertices, kVertexCount},
+                {kIndices, kIndexCount}, kPrimitive, kVertexCount, kIndexCount);
+            ptr->update(1, {kVertices, kVertexCount}, 0, {nullptr, 0});
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+            AssertThat(ptr->vertexCount(), Is().EqualTo(kVertexCount));
+        });
+
+        it("update: should throw InvalidArgument if an offset wraps past capacity", [&] {
+
+            auto ptr = renderer->makeGeometry({kVertices, kVertexCount},
+                {kIndices, kIndexCount}, kPrimitive, kVertexCount, kIndexCount);
+            Verify(::glMocked(), gl_BufferSubData(_, _, _, _)).Times(0);
+
+            ptr->update(0xFFFFFFFF, {kVertices, 1}, 0, {nullptr, 0});
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+            ptr->update(0, {nullptr, 0}, 0xFFFFFFFF, {kIndices, 1});
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+            AssertThat(ptr->vertexCount(), Is().EqualTo(kVertexCount));
+            AssertThat(ptr->indexCount(), Is().EqualTo(kIndexCount));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("update: should throw InvalidArgument if an index is out of capacity", [&] {
+
+            auto ptr = renderer->makeGeometry({kVertices, kVertexCount},
+                {kIndices, kIndexCount}, kPrimitive, kVertexCount + 1, kIndexCount);
+            const Geometry::Index indices[] = {kVertexCount, kVertexCount + 1, 0};
+            ptr->update(0, {nullptr, 0}, 0, {indices, 1});
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ptr->update(0, {nullptr, 0}, 0, {indices, 3});
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("resize: should shrink counts", [&] {
+
+            auto ptr = renderer->makeGeometry({kVertices, kVertexCount},
+                {kIndices, kIndexCount}, kPrimitive, kVertexCount, kIndexCount);
+            ptr->resize(3, 3);
+
+            AssertThat(ptr->vertexCount(), Is().EqualTo(3));
+            AssertThat(ptr->indexCount(), Is().EqualTo(3));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+        });
     });
 });
\ No newline at end of file
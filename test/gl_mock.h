@@ -12,12 +12,22 @@ public:
     MOCK_METHOD2(gl_DeleteBuffers, void  (GLsizei n, const GLuint * buffers));
     MOCK_METHOD2(gl_BindBuffer, void  (GLenum target, GLuint buffer));
     MOCK_METHOD4(gl_BufferData, void  (GLenum target, GLsizeiptr size, const GLvoid * data, GLenum usage));
+    MOCK_METHOD2(gl_MapBuffer, GLvoid * (GLenum target, GLenum access));
+    MOCK_METHOD1(gl_UnmapBuffer, GLboolean (GLenum target));
     MOCK_METHOD2(gl_GenTextures, void (GLsizei n, GLuint * textures));
     MOCK_METHOD2(gl_BindTexture, void (GLenum target, GLuint texture));
     MOCK_METHOD3(gl_TexParameteri, void (GLenum target, GLenum pname, GLint param));
     MOCK_METHOD2(gl_PixelStorei, void (GLenum pname, GLint param));
     MOCK_METHOD9(gl_TexImage2D, void (GLenum target, GLint level, GLint internalformat,
             GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid * pixels));
+    MOCK_METHOD9(gl_TexSubImage2D, void (GLenum target, GLint level, GLint xoffset, GLint yoffset,
+            GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid * pixels));
+    MOCK_METHOD8(gl_CompressedTexImage2D, void (GLenum target, GLint level, GLenum internalformat,
+            GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid * data));
+    MOCK_METHOD9(gl_CompressedTexSubImage2D, void (GLenum target, GLint level, GLint xoffset,
+            GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize,
+            const GLvoid * data));
+    MOCK_METHOD1(gl_GenerateMipmap, void (GLenum target));
     MOCK_METHOD1(gl_CompileShader, void  (GLuint shader));
     MOCK_METHOD4(gl_ShaderSource, void  (GLuint shader, GLsizei count,
             const GLchar ** strings, const GLint * lengths));
@@ -32,9 +42,18 @@ public:
     MOCK_METHOD1(gl_DeleteShader, void  (GLuint shader));
     MOCK_METHOD3(gl_GetShaderiv, void  (GLuint shader, GLenum pname, GLint * param));
     MOCK_METHOD2(gl_DetachShader, void  (GLuint program, GLuint shader));
+    MOCK_METHOD2(gl_GenQueries, void (GLsizei n, GLuint * ids));
+    MOCK_METHOD2(gl_DeleteQueries, void (GLsizei n, const GLuint * ids));
+    MOCK_METHOD2(gl_BeginQuery, void (GLenum target, GLuint id));
+    MOCK_METHOD1(gl_EndQuery, void (GLenum target));
+    MOCK_METHOD2(gl_QueryCounter, void (GLuint id, GLenum target));
+    MOCK_METHOD3(gl_GetQueryObjectiv, void (GLuint id, GLenum pname, GLint * params));
+    MOCK_METHOD3(gl_GetQueryObjectui64v, void (GLuint id, GLenum pname, GLuint64 * params));
     MOCK_METHOD1(gl_Disable, void (GLenum cap));
     MOCK_METHOD5(gl_DrawElementsInstanced, void  (GLenum arg0, GLsizei arg1, GLenum arg2,
             const GLvoid * arg3, GLsizei arg4));
+    MOCK_METHOD6(gl_DrawElementsInstancedBaseVertex, void  (GLenum mode, GLsizei count,
+            GLenum type, const GLvoid * indices, GLsizei primcount, GLint basevertex));
     MOCK_METHOD2(gl_DeleteTextures, void (GLsizei n, const GLuint * textures));
     MOCK_METHOD4(gl_BufferSubData, void  (GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid * data));
     MOCK_METHOD1(gl_DepthMask, void (GLboolean flag));
@@ -53,6 +72,22 @@ public:
     MOCK_METHOD1(gl_Clear, void (GLbitfield mask));
     MOCK_METHOD4(gl_ClearColor, void (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha));
     MOCK_METHOD1(gl_ClearDepth, void (GLclampd depth));
+    MOCK_METHOD2(gl_GenFramebuffers, void (GLsizei n, GLuint * framebuffers));
+    MOCK_METHOD2(gl_DeleteFramebuffers, void (GLsizei n, const GLuint * framebuffers));
+    MOCK_METHOD2(gl_BindFramebuffer, void (GLenum target, GLuint framebuffer));
+    MOCK_METHOD4(gl_FramebufferRenderbuffer, void (GLenum target, GLenum attachment,
+            GLenum renderbuffertarget, GLuint renderbuffer));
+    MOCK_METHOD1(gl_CheckFramebufferStatus, GLenum (GLenum target));
+    MOCK_METHOD2(gl_GenRenderbuffers, void (GLsizei n, GLuint * renderbuffers));
+    MOCK_METHOD2(gl_DeleteRenderbuffers, void (GLsizei n, const GLuint * renderbuffers));
+    MOCK_METHOD2(gl_BindRenderbuffer, void (GLenum target, GLuint renderbuffer));
+    MOCK_METHOD4(gl_RenderbufferStorage, void (GLenum target, GLenum internalformat,
+            GLsizei width, GLsizei height));
+    MOCK_METHOD7(gl_ReadPixels, void (GLint x, GLint y, GLsizei width, GLsizei height,
+            GLenum format, GLenum type, GLvoid * pixels));
+    MOCK_METHOD2(gl_FenceSync, GLsync (GLenum condition, GLbitfield flags));
+    MOCK_METHOD3(gl_ClientWaitSync, GLenum (GLsync sync, GLbitfield flags, GLuint64 timeout));
+    MOCK_METHOD1(gl_DeleteSync, void (GLsync sync));
 };
 
 inline GLMock& glMocked() {
@@ -69,6 +104,10 @@ inline GLMock& glMocked() {
 #define glBindBuffer glMocked().gl_BindBuffer
 #undef glBufferData
 #define glBufferData glMocked().gl_BufferData
+#undef glMapBuffer
+#define glMapBuffer glMocked().gl_MapBuffer
+#undef glUnmapBuffer
+#define glUnmapBuffer glMocked().gl_UnmapBuffer
 #undef glGenTextures
 #define glGenTextures glMocked().gl_GenTextures
 #undef glBindTexture
@@ -79,6 +118,14 @@ inline GLMock& glMocked() {
 #define glPixelStorei glMocked().gl_PixelStorei
 #undef glTexImage2D
 #define glTexImage2D glMocked().gl_TexImage2D
+#undef glTexSubImage2D
+#define glTexSubImage2D glMocked().gl_TexSubImage2D
+#undef glCompressedTexImage2D
+#define glCompressedTexImage2D glMocked().gl_CompressedTexImage2D
+#undef glCompressedTexSubImage2D
+#define glCompressedTexSubImage2D glMocked().gl_CompressedTexSubImage2D
+#undef glGenerateMipmap
+#define glGenerateMipmap glMocked().gl_GenerateMipmap
 #undef glCreateShader
 #define glCreateShader glMocked().gl_CreateShader
 #undef glShaderSource
@@ -109,6 +156,20 @@ inline GLMock& glMocked() {
 #define glewInit glMocked().glew_Init
 #undef glewIsSupported
 #define glewIsSupported glMocked().glew_IsSupported
+#undef glGenQueries
+#define glGenQueries glMocked().gl_GenQueries
+#undef glDeleteQueries
+#define glDeleteQueries glMocked().gl_DeleteQueries
+#undef glBeginQuery
+#define glBeginQuery glMocked().gl_BeginQuery
+#undef glEndQuery
+#define glEndQuery glMocked().gl_EndQuery
+#undef glQueryCounter
+#define glQueryCounter glMocked().gl_QueryCounter
+#undef glGetQueryObjectiv
+#define glGetQueryObjectiv glMocked().gl_GetQueryObjectiv
+#undef glGetQueryObjectui64v
+#define glGetQueryObjectui64v glMocked().gl_GetQueryObjectui64v
 #undef glDisable
 #define glDisable glMocked().gl_Disable
 #undef glDeleteTextures
@@ -117,6 +178,8 @@ inline GLMock& glMocked() {
 #define glDisable glMocked().gl_Disable
 #undef glDrawElementsInstanced
 #define glDrawElementsInstanced glMocked().gl_DrawElementsInstanced
+#undef glDrawElementsInstancedBaseVertex
+#define glDrawElementsInstancedBaseVertex glMocked().gl_DrawElementsInstancedBaseVertex
 #undef glBufferSubData
 #define glBufferSubData glMocked().gl_BufferSubData
 #undef glDepthMask
@@ -149,3 +212,29 @@ inline GLMock& glMocked() {
 #define glClearColor glMocked().gl_ClearColor
 #undef glClearDepth
 #define glClearDepth glMocked().gl_ClearDepth
+#undef glGenFramebuffers
+#define glGenFramebuffers glMocked().gl_GenFramebuffers
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers glMocked().gl_DeleteFramebuffers
+#undef glBindFramebuffer
+#define glBindFramebuffer glMocked().gl_BindFramebuffer
+#undef glFramebufferRenderbuffer
+#define glFramebufferRenderbuffer glMocked().gl_FramebufferRenderbuffer
+#undef glCheckFramebufferStatus
+#define glCheckFramebufferStatus glMocked().gl_CheckFramebufferStatus
+#undef glGenRenderbuffers
+#define glGenRenderbuffers glMocked().gl_GenRenderbuffers
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers glMocked().gl_DeleteRenderbuffers
+#undef glBindRenderbuffer
+#define glBindRenderbuffer glMocked().gl_BindRenderbuffer
+#undef glRenderbufferStorage
+#define glRenderbufferStorage glMocked().gl_RenderbufferStorage
+#undef glReadPixels
+#define glReadPixels glMocked().gl_ReadPixels
+#undef glFenceSync
+#define glFenceSync glMocked().gl_FenceSync
+#undef glClientWaitSync
+#define glClientWaitSync glMocked().gl_ClientWaitSync
+#undef glDeleteSync
+#define glDeleteSync glMocked().gl_DeleteSync
@@ -1,4 +1,5 @@
 #include "common.h"
+#include <vector>
 
 using namespace details;
 
@@ -63,6 +64,185 @@ go_bandit([] {
             AssertThat(getLastError(), Is().EqualTo(ErrorCode::OpenGLOutOfMemory));
         });
 
+        it("should be created with a packed format", [&] {
+
+            static const uint8_t kPackedBytes[kImageWidth * kImageHeight * 2] = {};
+
+            Verify(::glMocked(), gl_TexImage2D(GL_TEXTURE_2D, 0, GL_RGB5, kImageWidth, kImageHeight,
+                0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, nullptr)).Times(1);
+
+            auto ptr = renderer->makeImage(kImageSize, Image::Format::RGB565, kImageFilter);
+            ptr->upload({kPackedBytes, sizeof(kPackedBytes)});
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("should be created with a compressed format", [&] {
+
+            static const uint8_t kBlockBytes[8] = {};
+
+            Verify(::glMocked(), gl_TexImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+            Verify(::glMocked(), gl_CompressedTexImage2D(GL_TEXTURE_2D, 0,
+                GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, kImageWidth, kImageHeight, 0, 8, nullptr)).Times(1);
+            Verify(::glMocked(), gl_CompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                kImageWidth, kImageHeight, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 8, kBlockBytes)).Times(1);
+
+            auto ptr = renderer->makeImage(kImageSize, Image::Format::BC1, kImageFilter);
+            ptr->upload({kBlockBytes, sizeof(kBlockBytes)});
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("should throw OpenGLAbsentFeature if the format is not supported", [&] {
+
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_EXT_texture_compression_s3tc")))
+                .WillByDefault(Return(false));
+            renderer = makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+
+            AssertThat(renderer->supports(Image::Format::BC3), Is().EqualTo(false));
+            AssertThat(renderer->supports(Image::Format::BC7), Is().EqualTo(true));
+
+            auto ptr = renderer->makeImage(kImageSize, Image::Format::BC3, kImageFilter);
+
+            AssertThat(ptr, Is().EqualTo(ImagePtr()));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::OpenGLAbsentFeature));
+        });
+
+        it("upload: should throw InvalidArgument if compressed region is not block aligned", [&] {
+
+            static const uint8_t kBlockBytes[8] = {};
+
+            auto ptr = renderer->makeImage(kImageSize, Image::Format::ETC2, kImageFilter);
+            ptr->upload({1, 0, 2, 2}, {kBlockBytes, sizeof(kBlockBytes)}, 0);
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("mipmaps: should sample trilinear and generate levels after upload", [&] {
+
+            Verify(::glMocked(), gl_TexParameteri(_, _, _)).Times(::testing::AnyNumber());
+            Verify(::glMocked(), gl_TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                GL_LINEAR_MIPMAP_LINEAR)).Times(1);
+            Verify(::glMocked(), gl_GenerateMipmap(GL_TEXTURE_2D)).Times(1);
+
+            auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter, true);
+            ptr->upload({kBytes, kByteSize});
+
+            AssertThat(ptr->mipmaps(), Is().EqualTo(true));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("mipmaps: should filter levels on CPU if glGenerateMipmap is absent", [&] {
+
+            static const uint8_t kLevelBytes[] = {0x10, 0x20, 0x30, 0x40};
+
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_VERSION_3_0")))
+                .WillByDefault(Return(false));
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_ARB_framebuffer_object")))
+                .WillByDefault(Return(false));
+            renderer = makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+
+            uint8_t level = 0;
+            Verify(::glMocked(), gl_GenerateMipmap(_)).Times(0);
+            Verify(::glMocked(), gl_TexSubImage2D(_, 0, _, _, _, _, _, _, _)).Times(1);
+            Verify(::glMocked(), gl_TexSubImage2D(GL_TEXTURE_2D, 1, 0, 0, 1, 1,
+                GL_ALPHA, GL_UNSIGNED_BYTE, _)).WillOnce(::testing::Invoke(
+                    [&](GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum,
+                        const GLvoid* pixels) { level = *(const uint8_t*)pixels; }));
+
+            auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter, true);
+            ptr->upload({kLevelBytes, sizeof(kLevelBytes)});
+
+            AssertThat(level, Is().EqualTo(0x28));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("mipmaps: should filter on CPU only the footprint of an uploaded region", [&] {
+
+            static const uint8_t kPixel = 0xFC;
+            std::vector<uint8_t> zeros(8 * 8);
+
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_VERSION_3_0")))
+                .WillByDefault(Return(false));
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_ARB_framebuffer_object")))
+                .WillByDefault(Return(false));
+            renderer = makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            auto ptr = renderer->makeImage({8, 8}, kImageFormat, kImageFilter, true);
+            ptr->upload({zeros.data(), (uint32_t)zeros.size()});
+
+            std::vector<uint8_t> levels;
+            auto record = [&](GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum,
+                const GLvoid* pixels) { levels.push_back(*(const uint8_t*)pixels); };
+            Verify(::glMocked(), gl_TexSubImage2D(_, 0, 5, 2, 1, 1, _, _, _)).Times(1);
+            Verify(::glMocked(), gl_TexSubImage2D(_, 1, 2, 1, 1, 1, _, _, _))
+                .WillOnce(::testing::Invoke(record));
+            Verify(::glMocked(), gl_TexSubImage2D(_, 2, 1, 0, 1, 1, _, _, _))
+                .WillOnce(::testing::Invoke(record));
+            Verify(::glMocked(), gl_TexSubImage2D(_, 3, 0, 0, 1, 1, _, _, _))
+                .WillOnce(::testing::Invoke(record));
+
+            ptr->upload({5, 2, 6, 3}, {&kPixel, 1}, 0);
+
+            AssertThat(levels, Is().EqualTo(std::vector<uint8_t>({0x3F, 0x10, 0x04})));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("mipmaps: should filter rows of alpha and RGBA pixels as a box on CPU", [&] {
+
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_VERSION_3_0")))
+                .WillByDefault(Return(false));
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_ARB_framebuffer_object")))
+                .WillByDefault(Return(false));
+            renderer = makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+
+            for (auto channels : {1u, 4u}) {
+                const uint32_t width = 37, height = 3;
+                std::vector<uint8_t> bytes(width * height * channels);
+                for (size_t i = 0; i < bytes.size(); ++i)
+                    bytes[i] = uint8_t(i * 97 + i / 7);
+                std::vector<uint8_t> expected;
+                for (uint32_t y = 0; y < height / 2; ++y) {
+                    for (uint32_t x = 0; x < width / 2; ++x) {
+                        for (uint32_t c = 0; c < channels; ++c) {
+                            auto at = [&](uint32_t px, uint32_t py) {
+                                return bytes[(py * width + px) * channels + c];
+                            };
+                            expected.push_back(uint8_t((at(x * 2, y * 2) + at(x * 2 + 1, y * 2) +
+                                at(x * 2, y * 2 + 1) + at(x * 2 + 1, y * 2 + 1) + 2) / 4));
+                        }
+                    }
+                }
+
+                std::vector<uint8_t> level;
+                Verify(::glMocked(), gl_TexSubImage2D(_, _, _, _, _, _, _, _, _))
+                    .Times(::testing::AnyNumber());
+                Verify(::glMocked(), gl_TexSubImage2D(_, 1, 0, 0, width / 2, height / 2, _, _, _))
+                    .WillOnce(::testing::Invoke([&](GLenum, GLint, GLint, GLint, GLsizei,
+                        GLsizei, GLenum, GLenum, const GLvoid* pixels) {
+                        auto ptr = (const uint8_t*)pixels;
+                        level.assign(ptr, ptr + expected.size());
+                    }));
+
+                auto ptr = renderer->makeImage({width, height},
+                    channels == 1 ? Image::Format::A : Image::Format::RGBA, kImageFilter, true);
+                ptr->upload({bytes.data(), (uint32_t)bytes.size()});
+
+                AssertThat(level, Is().EqualTo(expected));
+                ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+            }
+        });
+
+        it("mipmaps: should throw InvalidArgument if format is compressed", [&] {
+
+            auto ptr = renderer->makeImage(kImageSize, Image::Format::BC1, kImageFilter, true);
+
+            AssertThat(ptr, Is().EqualTo(ImagePtr()));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
         it("upload: should upload bytes to the image", [&] {
 
             auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
@@ -86,5 +266,273 @@ go_bandit([] {
 
             AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
         });
+
+        it("upload: should upload a region without reallocation", [&] {
+
+            static const uint8_t kRegionBytes[] = {0x11, 0x22, 0x00, 0x33, 0x44, 0x00};
+
+            auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+
+            Verify(::glMocked(), gl_TexImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+            Verify(::glMocked(), gl_PixelStorei(_, _)).Times(::testing::AnyNumber());
+            Verify(::glMocked(), gl_PixelStorei(GL_UNPACK_ROW_LENGTH, 3)).Times(1);
+            Verify(::glMocked(), gl_PixelStorei(GL_UNPACK_ROW_LENGTH, 0)).Times(1);
+            Verify(::glMocked(), gl_TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 2, 2,
+                GL_ALPHA, GL_UNSIGNED_BYTE, kRegionBytes)).Times(1);
+
+            ptr->upload({0, 0, 2, 2}, {kRegionBytes, sizeof(kRegionBytes)}, 3);
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("upload: should throw InvalidArgument if region is outside of the image", [&] {
+
+            auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            ptr->upload({1, 1, 3, 2}, {kBytes, kByteSize}, 0);
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("upload: should throw InvalidArgument if stride is less than region row", [&] {
+
+            auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            ptr->upload({0, 0, 2, 2}, {kBytes, kByteSize}, 1);
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("upload: should throw InvalidArgument if bytes.count is not enough for region", [&] {
+
+            auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            ptr->upload({0, 0, 2, 2}, {kBytes, kByteSize}, 3);
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("upload: should throw InvalidArgument if a large stride wraps the region size", [&] {
+
+            // 1048833 * 4095 + 1 wraps to 3840 in 32 bits
+            std::vector<uint8_t> bytes(3840);
+            auto ptr = renderer->makeImage({1, 4096}, kImageFormat, kImageFilter);
+            Verify(::glMocked(), gl_TexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+
+            ptr->upload({0, 0, 1, 4096}, {bytes.data(), (uint32_t)bytes.size()}, 1048833);
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("uploadShared: should share texture of identical images", [&] {
+
+            auto ptr1 = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            auto ptr2 = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            ptr1->uploadShared({kBytes, kByteSize});
+
+            Verify(::glMocked(), gl_TexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(0);
+            Verify(::glMocked(), gl_DeleteTextures(_, _)).Times(1);
+
+            ptr2->uploadShared({kBytes, kByteSize});
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("uploadShared: should not share images differing in one byte", [&] {
+
+            // 40 bytes are hashed as one block of words and a tail of bytes
+            std::vector<uint8_t> bytes(40, 0xAA);
+            std::vector<ImagePtr> images;
+            Verify(::glMocked(), gl_TexSubImage2D(_, _, _, _, _, _, _, _, _)).Times(41);
+
+            for (size_t i = 0; i <= bytes.size(); ++i) {
+                auto changed = bytes;
+                if (i < changed.size())
+                    changed[i] ^= 1;
+                images.push_back(renderer->makeImage({8, 5}, kImageFormat, kImageFilter));
+                images.back()->uploadShared({changed.data(), (uint32_t)changed.size()});
+            }
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("uploadShared: should batch shapes of identical images together", [&] {
+
+            auto ptr1 = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            auto ptr2 = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            ptr1->uploadShared({kBytes, kByteSize});
+            ptr2->uploadShared({kBytes, kByteSize});
+
+            auto rect1 = renderer->makeRect();
+            rect1->image(ptr1);
+            rect1->visibility(true);
+            auto rect2 = renderer->makeRect();
+            rect2->image(ptr2);
+            rect2->visibility(true);
+
+            Verify(::glMocked(), gl_DrawElementsInstancedBaseVertex(_, _, _, _, 2, _)).Times(1);
+
+            AssertThat(renderer->draw(0), Is().EqualTo(2));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("upload: should make a private copy of a shared texture", [&] {
+
+            auto ptr1 = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            auto ptr2 = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            ptr1->uploadShared({kBytes, kByteSize});
+            ptr2->uploadShared({kBytes, kByteSize});
+
+            Verify(::glMocked(), gl_GenTextures(_, _)).Times(1);
+
+            ptr2->upload({kBytes, kByteSize});
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("textureBudget: should evict least recently drawn images and restore drawn ones", [&] {
+
+            auto ptr1 = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            auto ptr2 = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            ptr1->upload({kBytes, kByteSize});
+            ptr2->upload({kBytes, kByteSize});
+
+            auto rect = renderer->makeRect();
+            rect->image(ptr1);
+            rect->visibility(true);
+            renderer->textureBudget(kByteSize);
+
+            Verify(::glMocked(), gl_DeleteTextures(_, _)).Times(2);
+            renderer->draw(0);
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+
+            auto usage = renderer->textureUsage();
+            AssertThat(usage.bytes, Is().EqualTo(kByteSize));
+            AssertThat(usage.budget, Is().EqualTo(kByteSize));
+            AssertThat(usage.evictions, Is().EqualTo(2u));
+            AssertThat(usage.restores, Is().EqualTo(0u));
+
+            rect->image(ptr2);
+            Verify(::glMocked(), gl_TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                kImageWidth, kImageHeight, _, _, _)).Times(1);
+            renderer->draw(0);
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+
+            usage = renderer->textureUsage();
+            AssertThat(usage.bytes, Is().EqualTo(kByteSize));
+            AssertThat(usage.evictions, Is().EqualTo(3u));
+            AssertThat(usage.restores, Is().EqualTo(1u));
+        });
+
+        it("textureBudget: should restore the latest content without reading it back", [&] {
+
+            static const uint8_t kPixel = 0x55;
+            static const uint8_t kContent[kByteSize] = {kPixel, 0xAA, 0xAA, 0xAA};
+
+            auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+            ptr->upload({kBytes, kByteSize});
+            ptr->upload({0, 0, 1, 1}, {&kPixel, 1}, 0);
+            renderer->draw(0);
+            renderer->textureBudget(1);
+
+            auto rect = renderer->makeRect();
+            rect->image(ptr);
+            rect->visibility(true);
+
+            std::vector<uint8_t> restored;
+            Verify(::glMocked(), gl_TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                kImageWidth, kImageHeight, _, _, _)).WillOnce(::testing::Invoke(
+                    [&](GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum,
+                        const GLvoid* pixels) {
+                        auto bytes = (const uint8_t*)pixels;
+                        restored.assign(bytes, bytes + kByteSize);
+                    }));
+            renderer->draw(0);
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+
+            AssertThat(restored,
+                Is().EqualTo(std::vector<uint8_t>(kContent, kContent + kByteSize)));
+        });
+
+        it("textureBudget: should not evict streaming images", [&] {
+
+            auto ptr = renderer->makeStreamImage(kImageSize, kImageFormat, kImageFilter, 2);
+            renderer->draw(0);
+
+            renderer->textureBudget(1);
+
+            AssertThat(renderer->textureUsage().bytes, Is().EqualTo(kByteSize));
+        });
+
+        it("makeStreamImage: should be created", [&] {
+
+            auto ptr = renderer->makeStreamImage(kImageSize, kImageFormat, kImageFilter, 2);
+
+            AssertThat(ptr, Is().Not().EqualTo(ImagePtr()));
+            AssertThat(ptr->stream(), Is().EqualTo(true));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+        });
+
+        it("makeStreamImage: should throw InvalidArgument if bufferCount is out of range", [&] {
+
+            auto ptr = renderer->makeStreamImage(kImageSize, kImageFormat, kImageFilter,
+                Image::kMaxStreamBuffers + 1);
+
+            AssertThat(ptr, Is().EqualTo(ImagePtr()));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("lock: should transfer the frame through a pixel buffer at the next draw", [&] {
+
+            uint8_t frame[kByteSize] = {};
+            Given(::glMocked(), gl_MapBuffer(_, _)).WillByDefault(Return(frame));
+
+            auto ptr = renderer->makeStreamImage(kImageSize, kImageFormat, kImageFilter, 2);
+            auto bytes = ptr->lock();
+            AssertThat(bytes, Is().EqualTo(&frame[0]));
+            ptr->unlock();
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+
+            Verify(::glMocked(), gl_TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                kImageWidth, kImageHeight, _, _, nullptr)).Times(1);
+
+            renderer->draw(0);
+            renderer->draw(0);
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+            Given(::glMocked(), gl_MapBuffer(_, _)).WillByDefault(Return(nullptr));
+        });
+
+        it("lock: should not give a locked frame to another producer", [&] {
+
+            uint8_t frame[kByteSize] = {};
+            Given(::glMocked(), gl_MapBuffer(_, _)).WillByDefault(Return(frame));
+
+            auto ptr = renderer->makeStreamImage(kImageSize, kImageFormat, kImageFilter, 3);
+            AssertThat(ptr->lock(), Is().Not().EqualTo((uint8_t*)nullptr));
+            AssertThat(ptr->lock(), Is().EqualTo((uint8_t*)nullptr));
+            ptr->unlock();
+            AssertThat(ptr->lock(), Is().Not().EqualTo((uint8_t*)nullptr));
+            ptr->unlock();
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::NoError));
+            Given(::glMocked(), gl_MapBuffer(_, _)).WillByDefault(Return(nullptr));
+        });
+
+        it("lock: should throw InvalidArgument if the image is not a streaming one", [&] {
+
+            auto ptr = renderer->makeImage(kImageSize, kImageFormat, kImageFilter);
+
+            AssertThat(ptr->lock(), Is().EqualTo((uint8_t*)nullptr));
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
+
+        it("unlock: should throw InvalidArgument if the image is not locked", [&] {
+
+            auto ptr = renderer->makeStreamImage(kImageSize, kImageFormat, kImageFilter, 2);
+            ptr->unlock();
+
+            AssertThat(getLastError(), Is().EqualTo(ErrorCode::InvalidArgument));
+        });
     });
 });
\ No newline at end of file
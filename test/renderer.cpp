@@ -1,4 +1,8 @@
 #include "common.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
 
 using namespace details;
 
@@ -69,5 +73,404 @@ go_bandit([]{
             AssertThat(ptr->draw(color), Is().EqualTo(0));
             AssertThat(draw::getLastError(), Is().EqualTo(draw::ErrorCode::NoError));
         });
+
+        it("should be created without a context for the null backend", [&]{
+
+            Verify(::glMocked(), gl_GenBuffers(_, _)).Times(0);
+            Verify(::glMocked(), gl_DrawElementsInstanced(_, _, _, _, _)).Times(0);
+
+            auto ptr = draw::makeRenderer(nullptr, draw::Backend::Null);
+            AssertThat(ptr, Is().Not().EqualTo(draw::RendererPtr()));
+            ptr->resize({100, 100});
+            auto rect = ptr->makeRect();
+            rect->size({10, 10});
+            rect->visibility(true);
+            AssertThat(ptr->draw(0), Is().EqualTo(1));
+            AssertThat(ptr->glCalls().count, Is().EqualTo(0u));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("glCalls: should count calls and bytes per function of the counting backend", [&]{
+
+            auto ptr = draw::makeRenderer(nullptr, draw::Backend::Counting);
+            ptr->resize({100, 100});
+            auto rect = ptr->makeRect();
+            rect->size({10, 10});
+            rect->visibility(true);
+            ptr->draw(0);
+
+            auto find = [&ptr](const std::string& function) {
+                auto calls = ptr->glCalls();
+                for (uint32_t i = 0; i < calls.count; ++i) {
+                    if (function == calls.ptr[i].function)
+                        return calls.ptr[i];
+                }
+                return draw::GLCalls();
+            };
+            AssertThat(find("glewInit").calls, Is().EqualTo(1u));
+            AssertThat(find("glClear").calls, Is().EqualTo(1u));
+            AssertThat(find("glDrawElementsInstancedBaseVertex").calls, Is().EqualTo(1u));
+            AssertThat(find("glBufferSubData").bytes, Is().GreaterThanOrEqualTo(32u));
+            AssertThat(find("glTexSubImage2D").bytes, Is().EqualTo(4u));
+
+            ptr->draw(0);
+            AssertThat(find("glClear").calls, Is().EqualTo(2u));
+        });
+
+        it("glCalls: should not count calls of renderers on other threads", [&]{
+
+            // draws the same frames on this thread alone and next to a software renderer
+            auto drawCalls = [](bool concurrent) {
+                std::atomic<bool> done(false);
+                std::thread other;
+                if (concurrent) {
+                    other = std::thread([&done] {
+                        auto software = draw::makeRenderer(nullptr, draw::Backend::Software);
+                        software->resize({64, 64});
+                        auto rect = software->makeRect();
+                        rect->size({10, 10});
+                        rect->visibility(true);
+                        while (!done)
+                            software->draw(0);
+                    });
+                }
+                auto ptr = draw::makeRenderer(nullptr, draw::Backend::Counting);
+                ptr->resize({100, 100});
+                auto rect = ptr->makeRect();
+                rect->size({10, 10});
+                rect->visibility(true);
+                for (int i = 0; i < 2000; ++i)
+                    ptr->draw(0);
+                done = true;
+                if (other.joinable())
+                    other.join();
+
+                uint64_t total = 0;
+                auto calls = ptr->glCalls();
+                for (uint32_t i = 0; i < calls.count; ++i)
+                    total += calls.ptr[i].calls;
+                return total;
+            };
+            AssertThat(drawCalls(true), Is().EqualTo(drawCalls(false)));
+        });
+
+        it("pixels: should rasterize shapes and images on the CPU for the software backend", [&]{
+
+            static const uint8_t kRedGreen[] = {0xFF, 0x00, 0x00, 0x00, 0xFF, 0x00};
+            static const uint32_t kWidth = 200;
+
+            auto ptr = draw::makeRenderer(nullptr, draw::Backend::Software);
+            ptr->resize({kWidth, 100});
+            auto image = ptr->makeImage({2, 1}, draw::Image::Format::RGB, false);
+            image->upload({kRedGreen, sizeof(kRedGreen)});
+
+            auto rect = ptr->makeRect();
+            rect->position({0, 0});
+            rect->size({100, 50});
+            rect->image(image);
+            rect->visibility(true);
+            // 50% transparent red over the frame cleared to black
+            auto overlay = ptr->makeRect();
+            overlay->position({150, 0});
+            overlay->size({50, 100});
+            overlay->color(0x800000FF);
+            overlay->transparency(true);
+            overlay->visibility(true);
+
+            AssertThat(ptr->draw(0x000000FF), Is().EqualTo(2));
+
+            auto pixels = ptr->pixels();
+            AssertThat(pixels.count, Is().EqualTo(kWidth * 100 * 4));
+            // RGBA bytes of a pixel as 0xRRGGBBAA
+            auto pixel = [&pixels](uint32_t x, uint32_t y) {
+                auto* p = pixels.ptr + (y * kWidth + x) * 4;
+                return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+            };
+            AssertThat(pixel(10, 10), Is().EqualTo(0xFF0000FFu));
+            AssertThat(pixel(90, 49), Is().EqualTo(0x00FF00FFu));
+            AssertThat(pixel(10, 50), Is().EqualTo(0x000000FFu));
+            AssertThat(pixel(175, 99), Is().EqualTo(0x800000BFu));
+        });
+
+        it("pixels: should be empty for other backends", [&]{
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            ptr->draw(0);
+            AssertThat(ptr->pixels().count, Is().EqualTo(0u));
+        });
+
+        it("stats: should count batches, binds and uploaded instances of the frame", [&]{
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            ptr->resize({100, 100});
+            auto rect1 = ptr->makeRect();
+            rect1->size({10, 10});
+            rect1->visibility(true);
+            auto rect2 = ptr->makeRect();
+            rect2->size({10, 10});
+            rect2->visibility(true);
+
+            AssertThat(ptr->draw(0), Is().EqualTo(2));
+
+            auto stats = ptr->stats();
+            AssertThat(stats.batches, Is().EqualTo(1u));
+            AssertThat(stats.drawCalls, Is().EqualTo(1u));
+            AssertThat(stats.programBinds, Is().EqualTo(1u));
+            AssertThat(stats.textureBinds, Is().EqualTo(1u));
+            AssertThat(stats.instances, Is().EqualTo(2u));
+            AssertThat(stats.culledInstances, Is().EqualTo(0u));
+            AssertThat(stats.frameTimeP99, Is().GreaterThanOrEqualTo(stats.frameTimeP50));
+        });
+
+        it("stats: should count objects outside of the screen as culled", [&]{
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            ptr->resize({100, 100});
+            auto rect = ptr->makeRect();
+            rect->size({10, 10});
+            rect->position({200, 0});
+            rect->visibility(true);
+
+            Verify(::glMocked(), gl_DrawElementsInstancedBaseVertex(_, _, _, _, _, _)).Times(0);
+
+            AssertThat(ptr->draw(0), Is().EqualTo(0));
+            AssertThat(ptr->stats().culledInstances, Is().EqualTo(1u));
+            AssertThat(ptr->stats().drawCalls, Is().EqualTo(0u));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("gpuTiming: should read frame time queries with a few frames latency", [&]{
+
+            Given(::glMocked(), gl_GenQueries(_, _)).WillByDefault(SetArgPointee<1>(1));
+            Given(::glMocked(), gl_GetQueryObjectiv(_, GL_QUERY_RESULT_AVAILABLE, _))
+                .WillByDefault(SetArgPointee<2>(GL_TRUE));
+            Given(::glMocked(), gl_GetQueryObjectui64v(_, GL_QUERY_RESULT, _))
+                .WillByDefault(SetArgPointee<2>(2000000));
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            AssertThat(ptr->gpuTiming(true, false), Is().EqualTo(true));
+
+            Verify(::glMocked(), gl_BeginQuery(GL_TIME_ELAPSED, _)).Times(4);
+            Verify(::glMocked(), gl_GetQueryObjectui64v(_, _, _)).Times(1);
+
+            for (auto i = 0; i < 3; ++i)
+                ptr->draw(0);
+            AssertThat(ptr->stats().gpuTime, Is().EqualTo(0.0f));
+            ptr->draw(0);
+            AssertThat(ptr->stats().gpuTime, Is().EqualTo(2.0f));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("gpuTiming: should measure every draw call if requested", [&]{
+
+            // queries are named in order, the first one is the frame query, the draw
+            // call timestamps of the first frame are 2 and 3 ms
+            GLuint name = 0;
+            Given(::glMocked(), gl_GenQueries(_, _)).WillByDefault(::testing::Invoke(
+                [&name](GLsizei n, GLuint* ids) {
+                    for (GLsizei i = 0; i < n; ++i)
+                        ids[i] = ++name;
+                }));
+            Given(::glMocked(), gl_GetQueryObjectiv(_, GL_QUERY_RESULT_AVAILABLE, _))
+                .WillByDefault(SetArgPointee<2>(GL_TRUE));
+            Given(::glMocked(), gl_GetQueryObjectui64v(_, GL_QUERY_RESULT, _))
+                .WillByDefault(::testing::Invoke([](GLuint id, GLenum, GLuint64* result) {
+                    *result = id == 1 ? 5000000 : id * 1000000;
+                }));
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            ptr->resize({100, 100});
+            auto rect = ptr->makeRect();
+            rect->size({10, 10});
+            rect->visibility(true);
+            ptr->gpuTiming(true, true);
+
+            Verify(::glMocked(), gl_BeginQuery(GL_TIME_ELAPSED, _)).Times(4);
+            Verify(::glMocked(), gl_QueryCounter(_, GL_TIMESTAMP)).Times(8);
+
+            for (auto i = 0; i < 4; ++i)
+                ptr->draw(0);
+
+            auto stats = ptr->stats();
+            AssertThat(stats.gpuDrawCallTimes.count, Is().EqualTo(1u));
+            AssertThat(stats.gpuDrawCallTimes.ptr[0], Is().EqualTo(1.0f));
+            AssertThat(stats.gpuTime, Is().EqualTo(5.0f));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("gpuTiming: should stay disabled if ARB_timer_query is not supported", [&]{
+
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_ARB_timer_query")))
+                .WillByDefault(Return(false));
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+
+            Verify(::glMocked(), gl_BeginQuery(_, _)).Times(0);
+
+            AssertThat(ptr->gpuTiming(true, false), Is().EqualTo(false));
+            ptr->draw(0);
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("offscreen: should draw into a framebuffer of the screen size", [&]{
+
+            Given(::glMocked(), gl_GenFramebuffers(_, _)).WillByDefault(SetArgPointee<1>(5));
+            Given(::glMocked(), gl_CheckFramebufferStatus(GL_FRAMEBUFFER))
+                .WillByDefault(Return(GL_FRAMEBUFFER_COMPLETE));
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            ptr->resize({100, 100});
+
+            Verify(::glMocked(), gl_RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 100, 100))
+                .Times(1);
+            Verify(::glMocked(), gl_RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 50, 50))
+                .Times(1);
+            Verify(::glMocked(), gl_BindFramebuffer(GL_FRAMEBUFFER, 5)).Times(3);
+            Verify(::glMocked(), gl_BindFramebuffer(GL_FRAMEBUFFER, 0)).Times(3);
+
+            AssertThat(ptr->offscreen(true), Is().EqualTo(true));
+            ptr->draw(0);
+            ptr->resize({50, 50});
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+
+            Verify(::glMocked(), gl_BindFramebuffer(GL_FRAMEBUFFER, 5)).Times(0);
+            AssertThat(ptr->offscreen(false), Is().EqualTo(false));
+            ptr->draw(0);
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("offscreen: should stay disabled without framebuffer objects", [&]{
+
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_VERSION_3_0")))
+                .WillByDefault(Return(false));
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_ARB_framebuffer_object")))
+                .WillByDefault(Return(false));
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+
+            Verify(::glMocked(), gl_GenFramebuffers(_, _)).Times(0);
+
+            AssertThat(ptr->offscreen(true), Is().EqualTo(false));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("readPixels: should call back by a later draw once the fence is signaled", [&]{
+
+            static uint8_t pixels[40 * 30 * 4] = {};
+            Given(::glMocked(), gl_FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0))
+                .WillByDefault(Return(reinterpret_cast<GLsync>(1)));
+            Given(::glMocked(), gl_ClientWaitSync(_, _, _))
+                .WillByDefault(Return(GL_TIMEOUT_EXPIRED));
+            Given(::glMocked(), gl_MapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY))
+                .WillByDefault(Return(pixels));
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            ptr->resize({40, 30});
+
+            Verify(::glMocked(), gl_ReadPixels(0, 0, 40, 30, GL_RGBA, GL_UNSIGNED_BYTE, nullptr))
+                .Times(1);
+            Verify(::glMocked(), gl_DeleteSync(reinterpret_cast<GLsync>(1))).Times(1);
+
+            auto calls = 0u;
+            Image::Bytes result(nullptr, 0);
+            ptr->draw(0);
+            ptr->readPixels([&](Image::Bytes bytes, const Size& size) {
+                ++calls;
+                result = bytes;
+                AssertThat(size.width, Is().EqualTo(40u));
+                AssertThat(size.height, Is().EqualTo(30u));
+            });
+            ptr->draw(0);
+            AssertThat(calls, Is().EqualTo(0u));
+
+            Given(::glMocked(), gl_ClientWaitSync(_, _, _))
+                .WillByDefault(Return(GL_ALREADY_SIGNALED));
+            ptr->draw(0);
+            AssertThat(calls, Is().EqualTo(1u));
+            AssertThat(result.ptr, Is().EqualTo(static_cast<const uint8_t*>(pixels)));
+            AssertThat(result.count, Is().EqualTo(40u * 30u * 4u));
+            ptr->draw(0);
+            AssertThat(calls, Is().EqualTo(1u));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("finishReads: should wait for pending reads", [&]{
+
+            Given(::glMocked(), gl_FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0))
+                .WillByDefault(Return(reinterpret_cast<GLsync>(1)));
+            Given(::glMocked(), gl_ClientWaitSync(_, 0, 0))
+                .WillByDefault(Return(GL_TIMEOUT_EXPIRED));
+            Given(::glMocked(), gl_ClientWaitSync(_, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED))
+                .WillByDefault(Return(GL_CONDITION_SATISFIED));
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            auto calls = 0u;
+            ptr->draw(0);
+            ptr->readPixels([&](Image::Bytes, const Size&) { ++calls; });
+            ptr->readPixels([&](Image::Bytes, const Size&) { ++calls; });
+            ptr->draw(0);
+            AssertThat(calls, Is().EqualTo(0u));
+            ptr->finishReads();
+            AssertThat(calls, Is().EqualTo(2u));
+        });
+
+        it("readPixels: should read at once without pixel buffer objects", [&]{
+
+            Given(::glMocked(), glew_IsSupported(::testing::StrEq("GL_ARB_pixel_buffer_object")))
+                .WillByDefault(Return(false));
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            ptr->resize({8, 4});
+
+            Verify(::glMocked(), gl_ReadPixels(0, 0, 8, 4, GL_RGBA, GL_UNSIGNED_BYTE,
+                ::testing::NotNull())).Times(1);
+
+            auto count = 0u;
+            ptr->draw(0);
+            ptr->readPixels([&](Image::Bytes bytes, const Size&) { count = bytes.count; });
+            AssertThat(count, Is().EqualTo(8u * 4u * 4u));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("setTraceSink: should emit scope events around draw", [&]{
+
+            auto sink = std::make_shared<RecordingSink>();
+
+            auto ptr = draw::makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            draw::setTraceSink(sink);
+            ptr->draw(0);
+            draw::setTraceSink(nullptr);
+            ptr->draw(0);
+
+            AssertThat(sink->events.size(), Is().EqualTo(2u));
+            AssertThat(sink->events[0], Is().EqualTo("Renderer::draw"));
+        });
+
+        it("makeChromeTraceSink: should write trace event JSON", [&]{
+
+            static const char* kTracePath = "trace.json";
+            {
+                auto sink = draw::makeChromeTraceSink(kTracePath);
+                AssertThat(sink, Is().Not().EqualTo(draw::TraceSinkPtr()));
+                sink->begin("scope", 1);
+                sink->end("scope", 2);
+            }
+            std::ifstream file(kTracePath);
+            std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            file.close();
+            std::remove(kTracePath);
+
+            AssertThat(json, Is().StartingWith("{\"traceEvents\":["));
+            AssertThat(json, Is().Containing("\"name\":\"scope\",\"ph\":\"B\",\"ts\":1"));
+            AssertThat(json, Is().Containing("\"ph\":\"E\",\"ts\":2"));
+            AssertThat(json, Is().EndingWith("]}\n"));
+        });
+
+        it("makeChromeTraceSink: should throw InvalidArgument if filePath is invalid", [&]{
+
+            auto sink = draw::makeChromeTraceSink("");
+            AssertThat(sink, Is().EqualTo(draw::TraceSinkPtr()));
+            AssertThat(draw::getLastError(), Is().EqualTo(draw::ErrorCode::InvalidArgument));
+        });
     });
 });
\ No newline at end of file
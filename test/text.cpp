@@ -0,0 +1,228 @@
+#include "common.h"
+#include <string>
+#include <vector>
+
+using namespace details;
+
+go_bandit([] {
+
+    describe("draw::Text:", [] {
+
+        static auto kFontFilePath = "cour.ttf";
+        static auto kFontLetterSize = 12;
+
+        RendererPtr renderer;
+        FontPtr font;
+
+        before_each([&] {
+
+            mockGL();
+            renderer = makeRenderer(std::unique_ptr<ContextImpl>(new ContextImpl()));
+            renderer->resize({400, 400});
+            font = renderer->makeFont(kFontFilePath, kFontLetterSize);
+        });
+
+        after_each([&] {
+
+            font.reset();
+        });
+
+        it("should draw glyphs of texts with the same font as one batch", [&] {
+
+            auto text1 = renderer->makeText();
+            text1->font(font);
+            text1->text(L"Hello world");
+            text1->visibility(true);
+            auto text2 = renderer->makeText();
+            text2->font(font);
+            text2->text(L"draw");
+            text2->visibility(true);
+
+            AssertThat(renderer->draw(0), Is().EqualTo(14));
+            auto stats = renderer->stats();
+            AssertThat(stats.batches, Is().EqualTo(1u));
+            AssertThat(stats.drawCalls, Is().EqualTo(1u));
+            AssertThat(stats.instances, Is().EqualTo(14u));
+        });
+
+        it("should follow text, visibility and order changes", [&] {
+
+            auto ptr = renderer->makeText();
+            ptr->font(font);
+            ptr->text(L"abc");
+            AssertThat(renderer->draw(0), Is().EqualTo(0));
+
+            ptr->visibility(true);
+            AssertThat(renderer->draw(0), Is().EqualTo(3));
+            ptr->text(L"a b c d");
+            AssertThat(renderer->draw(0), Is().EqualTo(4));
+            ptr->order(5);
+            AssertThat(renderer->draw(0), Is().EqualTo(4));
+            ptr->text(L"");
+            AssertThat(renderer->draw(0), Is().EqualTo(0));
+            ptr->text(L"ab");
+            AssertThat(renderer->draw(0), Is().EqualTo(2));
+            ptr->visibility(false);
+            AssertThat(renderer->draw(0), Is().EqualTo(0));
+        });
+
+        it("should lay out changed and moved text the same way as new text", [&] {
+
+            auto software = makeRenderer(nullptr, Backend::Software);
+            software->resize({200, 40});
+            auto softwareFont = software->makeFont(kFontFilePath, kFontLetterSize);
+            auto render = [&software](const TextPtr& text) {
+                text->visibility(true);
+                auto pixels = drawPixels(software);
+                text->visibility(false);
+                return pixels;
+            };
+
+            auto changed = software->makeText();
+            changed->font(softwareFont);
+            changed->position({20, 30});
+            for (auto text : {L"Price 1234", L"Price 1299", L"Pr 99", L"", L"Price 12345"})
+                changed->text(text);
+            changed->horizAlign(Text::HorizAlign::Center);
+            changed->position({100, 10});
+            auto fresh = software->makeText();
+            fresh->font(softwareFont);
+            fresh->position({100, 10});
+            fresh->horizAlign(Text::HorizAlign::Center);
+            fresh->text(L"Price 12345");
+
+            AssertThat(changed->bounds(), Is().EqualTo(fresh->bounds()));
+            auto expected = render(fresh);
+            AssertThat(expected, Is().Not().EqualTo(render(software->makeText())));
+            AssertThat(render(changed), Is().EqualTo(expected));
+        });
+
+        it("should draw glyphs out of the alphabet from a page added on demand", [&] {
+
+            Verify(::glMocked(), gl_GenTextures(_, _)).Times(1);
+
+            auto text1 = renderer->makeText();
+            text1->font(font);
+            text1->text(L"\u041F\u0440\u0438\u0432\u0435\u0442");
+            text1->visibility(true);
+            AssertThat(renderer->draw(0), Is().EqualTo(6));
+            AssertThat(renderer->stats().batches, Is().EqualTo(1u));
+
+            auto text2 = renderer->makeText();
+            text2->font(font);
+            text2->text(L"Hi \u0434\u0430");
+            text2->visibility(true);
+            AssertThat(renderer->draw(0), Is().EqualTo(10));
+            AssertThat(renderer->stats().batches, Is().EqualTo(2u));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("should skip characters the font has no glyph of", [&] {
+
+            auto ptr = renderer->makeText();
+            ptr->font(font);
+            ptr->text(L"a\u4E00b");
+            ptr->visibility(true);
+            AssertThat(renderer->draw(0), Is().EqualTo(2));
+        });
+
+        it("should reuse slots of glyphs no text shows when a page is full", [&] {
+
+            // more characters than a page holds, shown one at a time
+            Verify(::glMocked(), gl_GenTextures(_, _)).Times(1);
+
+            auto ptr = renderer->makeText();
+            ptr->font(font);
+            ptr->visibility(true);
+            for (wchar_t c = 0xA0; c < 0x500; ++c) {
+                wchar_t text[] = {c, 0};
+                ptr->text(text);
+            }
+            ptr->text(L"\u0434");
+            AssertThat(renderer->draw(0), Is().EqualTo(1));
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("should keep glyphs shown by texts in their pages", [&] {
+
+            Verify(::glMocked(), gl_GenTextures(_, _)).Times(2);
+
+            // all the Cyrillic block takes more than a page
+            std::wstring text;
+            for (wchar_t c = 0x400; c < 0x500; ++c)
+                text.push_back(c);
+            auto ptr = renderer->makeText();
+            ptr->font(font);
+            ptr->text(text.c_str());
+            ::testing::Mock::VerifyAndClearExpectations(&::glMocked());
+        });
+
+        it("should draw texts of every letter size of a distance field font as one batch", [&] {
+
+            auto distanceFont = renderer->makeFont(kFontFilePath, kFontLetterSize, true);
+            AssertThat(distanceFont->distanceField(), Is().True());
+            auto small = renderer->makeText();
+            small->font(distanceFont);
+            small->text(L"small");
+            small->visibility(true);
+            auto large = renderer->makeText();
+            large->font(distanceFont);
+            large->letterSize(kFontLetterSize * 4);
+            large->text(L"small");
+            large->visibility(true);
+
+            AssertThat(renderer->draw(0), Is().EqualTo(10));
+            AssertThat(renderer->stats().batches, Is().EqualTo(1u));
+            auto width = [](const TextPtr& text) { return text->bounds().right - text->bounds().left; };
+            AssertThat(width(large), Is().EqualTo(width(small) * 4));
+        });
+
+        it("should render scaled distance field glyphs like glyphs of that size", [&] {
+
+            auto software = makeRenderer(nullptr, Backend::Software);
+            software->resize({400, 60});
+            // count of covered pixels of the text
+            auto coverage = [&software](const FontPtr& font, uint32_t letterSize) {
+                auto text = software->makeText();
+                text->font(font);
+                text->letterSize(letterSize);
+                text->position({10, 10});
+                text->text(L"Sharp 42 \u0434\u0436");
+                text->visibility(true);
+                auto pixels = drawPixels(software);
+                uint32_t count = 0;
+                for (size_t i = 0; i < pixels.size(); i += 4)
+                    count += pixels[i] >= 128;
+                return count;
+            };
+            auto distanceFont = software->makeFont(kFontFilePath, 24, true);
+            for (auto letterSize : {36u, 12u}) {
+                auto bitmap = coverage(software->makeFont(kFontFilePath, letterSize), 0);
+                auto distance = coverage(distanceFont, letterSize);
+                AssertThat(bitmap, Is().GreaterThan(0u));
+                AssertThat(distance, Is().GreaterThan(bitmap * 8 / 10));
+                AssertThat(distance, Is().LessThan(bitmap * 12 / 10));
+            }
+        });
+
+        it("should move bounds with position and alignment", [&] {
+
+            auto ptr = renderer->makeText();
+            ptr->font(font);
+            ptr->text(L"abcd");
+            auto width = ptr->bounds().right - ptr->bounds().left;
+            auto height = ptr->bounds().top - ptr->bounds().bottom;
+            AssertThat(width, Is().GreaterThan(0));
+
+            ptr->position({100, 50});
+            AssertThat(ptr->bounds(), Is().EqualTo(Rect(100, 50, 100 + width, 50 + height)));
+
+            ptr->horizAlign(Text::HorizAlign::Right);
+            ptr->vertAlign(Text::VertAlign::Bottom);
+            AssertThat(ptr->bounds(), Is().EqualTo(Rect(100 - width, 50 - height, 100, 50)));
+
+            ptr->text(L"ab");
+            AssertThat(ptr->bounds(), Is().EqualTo(Rect(100 - width / 2, 50 - height, 100, 50)));
+        });
+    });
+});